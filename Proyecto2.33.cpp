@@ -3,6 +3,40 @@
 #include <string>        // Librería para manejar strings (cadenas de texto)
 #include <ctime>         // Librería para manejar fechas y tiempo (para la "edad" de los nodos)
 #include <vector>        // Librería para usar vectores dinámicos (para listas de padres disponibles)
+#include <set>           // Librería para conjuntos ordenados (padres disponibles en orden por niveles)
+#include <climits>       // Librería con los límites de los tipos enteros (ULLONG_MAX)
+#include <new>           // Librería para el "placement new" (construir nodos dentro del pool)
+#include <type_traits>   // Librería para saber en compilación si Nodo necesita destructor
+#include <cstdlib>       // Librería para atoi (argumentos de la línea de comandos)
+#include <cstring>       // Librería para strcmp (comparar argumentos de la línea de comandos)
+#include <chrono>        // Librería para medir tiempos con precisión (benchmarks)
+#include <cstdio>        // Librería para leer archivos con búfer (fread) en el modo por lotes
+#include <cstdint>       // Librería con enteros de tamaño fijo (formato binario de las instantáneas)
+#include <atomic>        // Librería para contadores atómicos (memoria pedida, para los benchmarks)
+#include <fstream>       // Librería para archivos de texto (resultados y línea base de los benchmarks)
+#include <mutex>         // Librería para el cerrojo del escritor (un escritor, muchos lectores)
+#include <thread>        // Librería para hilos (benchmark de lectores concurrentes)
+#include <algorithm>     // Librería para binary_search, set_union, etc. (mapas de bits por atributo)
+#include <deque>         // Librería para colas dobles (historial de versiones: se agrega al final y se descarta al principio)
+#ifdef _WIN32
+#include <io.h>          // Librería para _commit (forzar la escritura a disco en Windows)
+#else
+#include <sys/resource.h> // Librería para getrusage (memoria máxima usada por el proceso)
+#include <sys/mman.h>    // Librería para mmap (mapear en memoria el archivo de instantánea)
+#include <sys/stat.h>    // Librería para fstat (tamaño del archivo)
+#include <fcntl.h>       // Librería para open
+#include <unistd.h>      // Librería para close y fsync
+#endif
+#ifdef __linux__
+#include <sys/epoll.h>   // Librería para epoll (bucle de eventos del modo servicio)
+#include <sys/socket.h>  // Librería para sockets
+#include <sys/un.h>      // Librería para sockets de dominio Unix
+#include <netinet/in.h>  // Librería para direcciones TCP
+#include <netinet/tcp.h> // Librería para TCP_NODELAY
+#include <arpa/inet.h>   // Librería para htons/htonl
+#include <csignal>       // Librería para SIGINT/SIGTERM (terminar el servicio guardando)
+#include <cerrno>        // Librería para errno (EAGAIN, EINTR)
+#endif
 
 using namespace std;     // Evita escribir std:: constantemente para tipos y funciones estándar
 
@@ -20,29 +54,421 @@ using namespace std;     // Evita escribir std:: constantemente para tipos y fun
 // --------------------------------------
 time_t start_time = time(NULL);  // Almacena el número de segundos transcurridos desde 1/1/1970 al inicio del programa
 
+// Reloj de las edades. Tres modos:
+//  - RELOJ_GRUESO: refrescar() lee time() y el valor se usa hasta el siguiente refrescar()
+//    (se refresca por cada lote de operaciones, no por cada nodo).
+//  - RELOJ_MONOTONICO: steady_clock en cada lectura; no salta si cambian la hora del sistema.
+//  - RELOJ_SIMULADO: solo avanza con avanzar(); sirve para probar la regla de los 60 años.
+// Al cambiar de modo el valor sigue desde donde estaba, así las edades no saltan.
+// Solo el escritor lo cambia (refrescar, cambiarModo, avanzar); los campos son atómicos para que
+// un hilo lector pueda leer la hora mientras tanto. Un lector que lee justo durante cambiarModo
+// puede ver una edad del modo anterior.
+enum ModoReloj { RELOJ_GRUESO, RELOJ_MONOTONICO, RELOJ_SIMULADO };
+
+struct Reloj {
+    atomic<ModoReloj> modo;
+    atomic<int> desplazamiento; // Se suma a la lectura cruda para que los cambios de modo sean continuos
+    atomic<int> cache;          // Valor del modo grueso, publicado por refrescar()
+    atomic<int> simulado;       // Segundos del reloj simulado
+    chrono::steady_clock::time_point inicio; // Origen del modo monotónico (no cambia)
+
+    Reloj() : modo(RELOJ_GRUESO), desplazamiento(0), cache(0), simulado(0),
+              inicio(chrono::steady_clock::now()) {}
+
+    int crudo() const {
+        switch (modo.load(memory_order_relaxed)) {
+            case RELOJ_MONOTONICO:
+                return (int)chrono::duration_cast<chrono::seconds>(chrono::steady_clock::now() - inicio).count();
+            case RELOJ_SIMULADO:
+                return simulado.load(memory_order_relaxed);
+            default:
+                return cache.load(memory_order_relaxed);
+        }
+    }
+
+    // "Años" (segundos) transcurridos desde el inicio
+    int ahora() const { return crudo() + desplazamiento.load(memory_order_relaxed); }
+
+    // Comienza un lote nuevo: el modo grueso vuelve a leer la hora
+    void refrescar() { cache.store((int)difftime(time(NULL), start_time), memory_order_relaxed); }
+
+    void cambiarModo(ModoReloj nuevo) {
+        int antes = ahora();
+        refrescar();
+        if (nuevo == RELOJ_SIMULADO) simulado.store(0, memory_order_relaxed);
+        modo.store(nuevo, memory_order_relaxed);
+        desplazamiento.store(antes - crudo(), memory_order_relaxed); // crudo() ya lee el modo nuevo
+    }
+
+    void avanzar(int segundos) { // Solo tiene efecto en modo simulado
+        simulado.store(simulado.load(memory_order_relaxed) + segundos, memory_order_relaxed);
+    }
+};
+
+Reloj reloj; // Reloj que usan todas las edades
+
 // Función para calcular los "años" (segundos) transcurridos desde el inicio del programa
 int yearsElapsed() {
-    return (int)(difftime(time(NULL), start_time));  // Calcula la diferencia entre el tiempo actual y el tiempo inicial, y lo devuelve como entero
+    return reloj.ahora(); // Según el modo: valor guardado del lote, monotónico o simulado
+}
+
+// Los archivos guardan los nacimientos como momentos absolutos (segundos desde 1/1/1970), pero el
+// reloj de las edades solo sigue la hora del sistema en modo grueso. Para pasar de uno a otro se usa
+// la diferencia entre un momento absoluto y la lectura del reloj: al guardar, momento = nacimiento +
+// diferenciaReloj(time(NULL)); al cargar, nacimiento = momento - diferenciaReloj(hora del guardado).
+// Así cada edad queda como estaba al guardar, en cualquier modo del reloj.
+int64_t diferenciaReloj(int64_t momento) {
+    return momento - yearsElapsed();
+}
+
+// --------------------------------------
+// ATRIBUTOS DE LOS PERSONAJES
+// --------------------------------------
+// Cada atributo tiene pocos valores posibles: se guardan como enumeraciones (enteros pequeños)
+// y el texto de cada valor se guarda una sola vez en estas tablas para mostrarlo.
+enum Tipo   { TIPO_AGUA, TIPO_FUEGO, TIPO_ROCA };
+enum Genero { GENERO_HOMBRE, GENERO_MUJER, GENERO_NINGUNO };
+enum Estado { ESTADO_VIVO, ESTADO_MUERTO };
+
+const string TEXTO_TIPO[]   = { "Agua", "Fuego", "Roca" };      // Texto de cada Tipo
+const string TEXTO_GENERO[] = { "Hombre", "Mujer", "None" };    // Texto de cada Genero
+const string TEXTO_ESTADO[] = { "Vivo", "Muerto" };             // Texto de cada Estado
+
+// Busca 'texto' (de 'largo' caracteres) en una tabla de textos; devuelve su posición o -1 si no está
+int valorDesdeTexto(const string* tabla, int cantidad, const char* texto, size_t largo) {
+    for (int i = 0; i < cantidad; i++)
+        if (tabla[i].size() == largo && memcmp(tabla[i].data(), texto, largo) == 0) return i;
+    return -1;
+}
+
+// Convierten un texto en el valor del atributo; devuelven -1 si el texto no es válido
+int tipoDesdeTexto(const char* t, size_t largo)   { return valorDesdeTexto(TEXTO_TIPO, 3, t, largo); }
+int generoDesdeTexto(const char* g, size_t largo) { return valorDesdeTexto(TEXTO_GENERO, 3, g, largo); }
+int estadoDesdeTexto(const char* e, size_t largo) { return valorDesdeTexto(TEXTO_ESTADO, 2, e, largo); }
+
+const string TEXTO_RELOJ[] = { "grueso", "mono", "sim" }; // Texto de cada ModoReloj (opciones y lotes)
+int modoRelojDesdeTexto(const char* m, size_t largo) { return valorDesdeTexto(TEXTO_RELOJ, 3, m, largo); }
+
+// Cómo elige el árbol el padre de un personaje nuevo cuando no se indica (INSERT ... AUTO):
+//  - UBICAR_NIVEL: el lugar libre menos profundo (el primero en orden BFS)
+//  - UBICAR_LINAJES: por turnos entre los linajes de los hijos de la raíz, en el lugar libre menos profundo de cada uno
+//  - UBICAR_POBLACION: baja siempre por el subárbol con menos personajes hasta un nodo con lugar
+enum PoliticaUbicacion { UBICAR_NIVEL, UBICAR_LINAJES, UBICAR_POBLACION };
+const string TEXTO_POLITICA[] = { "nivel", "linajes", "poblacion" }; // Texto de cada PoliticaUbicacion
+int politicaDesdeTexto(const char* p, size_t largo) { return valorDesdeTexto(TEXTO_POLITICA, 3, p, largo); }
+
+// --------------------------------------
+// ARENA DE NOMBRES
+// --------------------------------------
+// Guarda todos los nombres, uno tras otro, en bloques grandes de caracteres. Los nodos solo
+// apuntan a su nombre. Un nombre no se borra al eliminar su nodo: la memoria vuelve con reiniciar().
+struct ArenaNombres {
+    static const size_t TAM_BLOQUE = 64 * 1024; // Tamaño de cada bloque de caracteres
+
+    vector<char*> bloques; // Bloques reservados
+    size_t usado;          // Caracteres usados del último bloque
+
+    ArenaNombres() {
+        usado = TAM_BLOQUE; // Obliga a pedir un bloque en el primer guardado
+    }
+
+    ~ArenaNombres() {
+        reiniciar();
+    }
+
+    ArenaNombres(const ArenaNombres&) = delete;
+    ArenaNombres& operator=(const ArenaNombres&) = delete;
+
+    // Copia el nombre (con su '\0' final) a la arena y devuelve dónde quedó
+    const char* guardar(const char* texto, size_t largo) {
+        char* destino;
+        if (largo + 1 > TAM_BLOQUE) {             // Un nombre enorme tiene su propio bloque
+            destino = new char[largo + 1];
+            bloques.insert(bloques.begin(), destino); // Se pone al principio para no perder el bloque actual
+        } else {
+            if (bloques.empty() || usado + largo + 1 > TAM_BLOQUE) { // No cabe: pide un bloque nuevo
+                bloques.push_back(new char[TAM_BLOQUE]);
+                usado = 0;
+            }
+            destino = bloques.back() + usado;
+            usado += largo + 1;
+        }
+        memcpy(destino, texto, largo);
+        destino[largo] = '\0';
+        return destino;
+    }
+
+    // Libera todos los bloques de una vez
+    void reiniciar() {
+        for (size_t i = 0; i < bloques.size(); i++) delete[] bloques[i];
+        bloques.clear();
+        usado = TAM_BLOQUE;
+    }
+};
+
+// --------------------------------------
+// CONTADOR DE MEMORIA PEDIDA (solo en la compilación para benchmarks)
+// --------------------------------------
+// Compilando con -DCONTAR_ASIGNACIONES se reemplazan los operadores new/delete globales para
+// contar cuántas veces y cuántos bytes se piden (la columna asignaciones_op del bench). En el
+// programa normal new queda como está: ningún contador compartido en cada asignación.
+#ifdef CONTAR_ASIGNACIONES
+const bool CONTANDO_ASIGNACIONES = true;
+#else
+const bool CONTANDO_ASIGNACIONES = false;
+#endif
+atomic<unsigned long long> totalAsignaciones(0); // Cantidad de llamadas a new (siempre 0 sin CONTAR_ASIGNACIONES)
+atomic<unsigned long long> totalBytesPedidos(0); // Bytes pedidos en total (no se restan al liberar)
+
+#ifdef CONTAR_ASIGNACIONES
+#ifdef __GNUC__
+#define SIN_INLINE __attribute__((noinline)) // Evita que GCC mezcle new/delete propios con malloc/free al optimizar
+#else
+#define SIN_INLINE
+#endif
+
+SIN_INLINE void* operator new(size_t tam) {
+    totalAsignaciones.fetch_add(1, memory_order_relaxed);
+    totalBytesPedidos.fetch_add(tam, memory_order_relaxed);
+    void* p = malloc(tam ? tam : 1);
+    if (!p) throw bad_alloc();
+    return p;
+}
+SIN_INLINE void operator delete(void* p) noexcept { free(p); }
+SIN_INLINE void operator delete(void* p, size_t) noexcept { free(p); }
+#endif
+
+// Memoria máxima (en KB) que llegó a ocupar el proceso; 0 si el sistema no lo informa
+long memoriaPicoKb() {
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage uso;
+    getrusage(RUSAGE_SELF, &uso);
+    return uso.ru_maxrss; // En Linux ya viene en KB
+#endif
+}
+
+// --------------------------------------
+// MÉTRICAS DE LAS OPERACIONES
+// --------------------------------------
+// Cada hilo cuenta sus operaciones y guarda sus latencias en histogramas propios (thread_local):
+// registrar una medición no toma cerrojos ni comparte líneas de caché con otros hilos. Solo el
+// volcado suma los histogramas de todos los hilos.
+enum Operacion {
+    OP_INSERTAR, OP_ELIMINAR, OP_BUSCAR, OP_PADRES_DISPONIBLES, OP_GENERACIONES,
+    OP_PREORDEN, OP_INORDEN, OP_POSTORDEN, OP_ARBOL_VERTICAL, CANTIDAD_OPERACIONES
+};
+const char* const TEXTO_OPERACION[] = {
+    "insertar", "eliminar", "buscar", "padresDisponibles", "mostrarGeneraciones",
+    "preorden", "inorden", "postorden", "mostrarArbolVertical"
+};
+// Se mide 1 de cada N llamadas (potencia de 2). Las operaciones de pocos nanosegundos se
+// muestrean para que leer el reloj no cueste más que la operación; la cantidad sí es exacta.
+const unsigned int MUESTREO_OPERACION[] = { 8, 8, 64, 1, 1, 1, 1, 1, 1 };
+
+// Histograma de latencias al estilo HDR: hasta 32 ns cada valor tiene su casilla y después cada
+// potencia de 2 se parte en 16 casillas, así el error relativo es menor al 6,25% en todo el rango
+// (hasta 2^42 ns, más de una hora). Los contadores son atómicos solo para que el volcado pueda
+// leerlos desde otro hilo: el dueño los actualiza con carga y guardado relajados (sin lock).
+struct Histograma {
+    static const unsigned int BITS_SUB = 4;
+    static const unsigned int SUB = 1u << BITS_SUB;   // Casillas por potencia de 2
+    static const unsigned int BITS_MAXIMO = 42;       // Valores mayores se anotan en la última casilla
+    static const unsigned int CASILLAS = 2 * SUB + (BITS_MAXIMO - BITS_SUB) * SUB;
+
+    atomic<unsigned long long> casillas[CASILLAS];
+    atomic<unsigned long long> llamadas;  // Todas las llamadas (medidas o no)
+    atomic<unsigned long long> sumaNs;    // Suma de las latencias medidas
+    atomic<unsigned long long> maximoNs;
+
+    Histograma() { limpiar(); }
+
+    void limpiar() {
+        for (unsigned int i = 0; i < CASILLAS; i++) casillas[i].store(0, memory_order_relaxed);
+        llamadas.store(0, memory_order_relaxed);
+        sumaNs.store(0, memory_order_relaxed);
+        maximoNs.store(0, memory_order_relaxed);
+    }
+
+    static unsigned int casilla(unsigned long long ns) {
+        if (ns < 2 * SUB) return (unsigned int)ns;
+#ifdef __GNUC__
+        unsigned int bits = 63 - __builtin_clzll(ns); // Posición del bit más alto
+#else
+        unsigned int bits = 0;
+        for (unsigned long long v = ns; v >>= 1; ) bits++;
+#endif
+        if (bits >= BITS_MAXIMO) return CASILLAS - 1;
+        unsigned int corrimiento = bits - BITS_SUB;
+        return 2 * SUB + (corrimiento - 1) * SUB + (unsigned int)((ns >> corrimiento) - SUB);
+    }
+
+    // Mayor valor que cae en la casilla 'i'
+    static unsigned long long techo(unsigned int i) {
+        if (i < 2 * SUB) return i;
+        unsigned int corrimiento = (i - 2 * SUB) / SUB + 1;
+        unsigned long long mantisa = (i - 2 * SUB) % SUB + SUB;
+        return ((mantisa + 1) << corrimiento) - 1;
+    }
+
+    static void sumarRelajado(atomic<unsigned long long>& c, unsigned long long v) {
+        c.store(c.load(memory_order_relaxed) + v, memory_order_relaxed);
+    }
+
+    void anotar(unsigned long long ns) {
+        sumarRelajado(casillas[casilla(ns)], 1);
+        sumarRelajado(sumaNs, ns);
+        if (ns > maximoNs.load(memory_order_relaxed)) maximoNs.store(ns, memory_order_relaxed);
+    }
+
+    // Suma otro histograma (lo usa el volcado; 'otro' puede estar cambiando)
+    void sumar(const Histograma& otro) {
+        for (unsigned int i = 0; i < CASILLAS; i++) sumarRelajado(casillas[i], otro.casillas[i].load(memory_order_relaxed));
+        sumarRelajado(llamadas, otro.llamadas.load(memory_order_relaxed));
+        sumarRelajado(sumaNs, otro.sumaNs.load(memory_order_relaxed));
+        unsigned long long m = otro.maximoNs.load(memory_order_relaxed);
+        if (m > maximoNs.load(memory_order_relaxed)) maximoNs.store(m, memory_order_relaxed);
+    }
+
+    unsigned long long muestras() const {
+        unsigned long long total = 0;
+        for (unsigned int i = 0; i < CASILLAS; i++) total += casillas[i].load(memory_order_relaxed);
+        return total;
+    }
+
+    // Latencia por debajo de la cual queda la fracción 'q' de las muestras (0 si no hay)
+    unsigned long long percentil(double q) const {
+        unsigned long long total = muestras();
+        if (total == 0) return 0;
+        unsigned long long objetivo = (unsigned long long)(q * total + 0.999999);
+        if (objetivo == 0) objetivo = 1;
+        unsigned long long acumulado = 0;
+        for (unsigned int i = 0; i < CASILLAS; i++) {
+            acumulado += casillas[i].load(memory_order_relaxed);
+            if (acumulado >= objetivo) return min(techo(i), maximoNs.load(memory_order_relaxed));
+        }
+        return maximoNs.load(memory_order_relaxed);
+    }
+
+    // Muestras con latencia <= 'ns' (para las casillas acumuladas de Prometheus)
+    unsigned long long hasta(unsigned long long ns) const {
+        unsigned long long total = 0;
+        for (unsigned int i = 0; i < CASILLAS && techo(i) <= ns; i++) total += casillas[i].load(memory_order_relaxed);
+        return total;
+    }
+};
+
+// Histogramas de un hilo. Al terminar el hilo sus números pasan a 'terminados'.
+struct MetricasHilo {
+    Histograma porOperacion[CANTIDAD_OPERACIONES];
+    MetricasHilo();
+    ~MetricasHilo();
+};
+
+// Registro de los hilos que midieron algo
+struct RegistroMetricas {
+    mutex cerrojo;
+    vector<MetricasHilo*> hilos;
+    Histograma terminados[CANTIDAD_OPERACIONES]; // De los hilos que ya terminaron
+
+    // Suma de todos los hilos, por operación
+    void juntar(Histograma* total) {
+        lock_guard<mutex> c(cerrojo);
+        for (int op = 0; op < CANTIDAD_OPERACIONES; op++) {
+            total[op].limpiar();
+            total[op].sumar(terminados[op]);
+            for (size_t h = 0; h < hilos.size(); h++) total[op].sumar(hilos[h]->porOperacion[op]);
+        }
+    }
+};
+RegistroMetricas registroMetricas;
+
+MetricasHilo::MetricasHilo() {
+    lock_guard<mutex> c(registroMetricas.cerrojo);
+    registroMetricas.hilos.push_back(this);
+}
+
+MetricasHilo::~MetricasHilo() {
+    lock_guard<mutex> c(registroMetricas.cerrojo);
+    for (int op = 0; op < CANTIDAD_OPERACIONES; op++) registroMetricas.terminados[op].sumar(porOperacion[op]);
+    registroMetricas.hilos.erase(find(registroMetricas.hilos.begin(), registroMetricas.hilos.end(), this));
 }
 
+MetricasHilo& metricasDelHilo() {
+    static thread_local MetricasHilo metricas; // Se registra la primera vez que el hilo mide algo
+    return metricas;
+}
+
+// Mide una operación mientras existe (se crea al principio de la función medida)
+struct MedirOperacion {
+    Histograma* histograma; // NULL si esta llamada no se muestrea
+    chrono::steady_clock::time_point inicio;
+
+    explicit MedirOperacion(Operacion op) {
+        Histograma& h = metricasDelHilo().porOperacion[op];
+        unsigned long long n = h.llamadas.load(memory_order_relaxed);
+        h.llamadas.store(n + 1, memory_order_relaxed);
+        histograma = (n & (MUESTREO_OPERACION[op] - 1)) == 0 ? &h : NULL;
+        if (histograma) inicio = chrono::steady_clock::now();
+    }
+
+    ~MedirOperacion() {
+        if (histograma) histograma->anotar((unsigned long long)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - inicio).count());
+    }
+};
+
+// --------------------------------------
+// ENLACES ENTRE NODOS
+// --------------------------------------
+// Puntero que un hilo escritor puede cambiar mientras otros hilos lo leen. Se usa como un Nodo*
+// normal: leerlo es una carga "acquire" y asignarlo un almacenamiento "release", así quien
+// llega a un nodo por un enlace ve el nodo ya construido. En x86 cuesta lo mismo que un puntero.
+struct Nodo;
+struct Enlace {
+    atomic<Nodo*> p;
+
+    operator Nodo*() const { return p.load(memory_order_acquire); }
+    Nodo* operator->() const { return p.load(memory_order_acquire); }
+    Enlace& operator=(Nodo* n) { p.store(n, memory_order_release); return *this; }
+};
+
+// Estado (Vivo/Muerto) que el escritor puede cambiar mientras otros hilos lo leen. Es el único
+// atributo que cambia después de enlazar el nodo; va en un byte propio (no en el campo de bits de
+// tipo y género) para que cambiarlo no toque la memoria que leen los demás.
+struct EstadoCompartido {
+    atomic<unsigned char> e;
+
+    operator Estado() const { return (Estado)e.load(memory_order_relaxed); }
+    EstadoCompartido& operator=(Estado nuevo) { e.store((unsigned char)nuevo, memory_order_relaxed); return *this; }
+};
+
 // --------------------------------------
 // NODO DEL ÁRBOL
 // --------------------------------------
+const int MAX_HIJOS = 2; // Hijos por nodo del árbol genealógico (izquierda y derecha)
+
 struct Nodo {
-    string nombre;   // Nombre único del personaje
-    string tipo;     // Tipo de elemento del personaje (Agua, Fuego, Roca, etc.)
-    string genero;   // Género del personaje (Hombre, Mujer)
-    string estado;   // Estado del personaje (Vivo, Muerto)
+    const char* nombre;  // Nombre único del personaje (guardado en la ArenaNombres del árbol)
+    unsigned int largo;  // Cantidad de caracteres del nombre
+    unsigned char tipo   : 2; // Tipo de elemento del personaje (Tipo: Agua, Fuego, Roca)
+    unsigned char genero : 2; // Género del personaje (Genero: Hombre, Mujer, None)
+    EstadoCompartido estado;  // Estado del personaje (Estado: Vivo, Muerto); ocupa el hueco tras los bits
     int nacimiento;  // El tiempo (en "años"/segundos) en que se creó este nodo
+    int profundidad; // Generación del nodo (la raíz es la generación 0)
+    unsigned long long orden; // Etiqueta de posición dentro de su generación (ordena los nodos como el BFS)
+    unsigned int id; // Índice de 32 bits del nodo dentro del pool (lo asigna PoolNodos)
+    unsigned int salto; // Id de un ancestro lejano (puntero de salto, ver PoolNodos::crear); ocupa el hueco tras 'id'
 
-    Nodo* padre;     // Puntero al nodo padre en el árbol
-    Nodo* izquierda; // Puntero al hijo izquierdo
-    Nodo* derecha;   // Puntero al hijo derecho
+    Nodo* padre;      // Puntero al nodo padre en el árbol (no cambia después de crear el nodo)
+    Enlace izquierda; // Puntero al hijo izquierdo (lo pueden leer otros hilos mientras cambia)
+    Enlace derecha;   // Puntero al hijo derecho
 
     // Constructor del nodo: inicializa todos los campos al crear un nuevo Nodo
-    Nodo(string n, string t, string g, string e, Nodo* p)
+    Nodo(const char* n, unsigned int l, Tipo t, Genero g, Estado e, Nodo* p)
     {
-        nombre = n;      // Asigna el nombre
+        nombre = n;      // Asigna el nombre (ya guardado en la arena)
+        largo = l;       // Asigna el largo del nombre
         tipo = t;        // Asigna el tipo
         genero = g;      // Asigna el género
         estado = e;      // Asigna el estado
@@ -50,6 +476,10 @@ struct Nodo {
         izquierda = NULL; // Inicializa el puntero del hijo izquierdo a nulo (sin hijo)
         derecha = NULL;  // Inicializa el puntero del hijo derecho a nulo (sin hijo)
         nacimiento = yearsElapsed(); // Guarda el tiempo actual como la edad de creación
+        profundidad = p ? p->profundidad + 1 : 0; // Una generación más que su padre
+        orden = 0;       // La etiqueta de orden la asigna el árbol al enlazar el nodo
+        id = 0;          // El índice lo asigna el pool al reservar el nodo
+        salto = 0;       // También lo asigna el pool
     }
 
     // Función para obtener la edad actual del nodo en "años" (segundos)
@@ -57,6 +487,16 @@ struct Nodo {
         return yearsElapsed() - nacimiento; // Calcula la diferencia entre el tiempo actual y el tiempo de nacimiento
     }
 
+    // Textos de los atributos (salen de las tablas, no se guardan en el nodo)
+    const string& tipoTexto() const   { return TEXTO_TIPO[tipo]; }
+    const string& generoTexto() const { return TEXTO_GENERO[genero]; }
+    const string& estadoTexto() const { return TEXTO_ESTADO[estado]; }
+
+    // Indica si el nombre del nodo es exactamente 'otro'
+    bool tieneNombre(const char* otro, size_t l) const {
+        return largo == l && memcmp(nombre, otro, l) == 0;
+    }
+
     // Función que devuelve la cantidad de hijos directos del nodo
     int hijos() {
         int h = 0;           // InicializSa el contador de hijos a cero
@@ -69,315 +509,4992 @@ struct Nodo {
 // =========================
 // Función para colorear nodos
 // =========================
+// Devuelve la secuencia ANSI con la que se pinta un nodo según su tipo
+const char* codigoColor(Nodo* nodo) {
+    if (nodo->tipo == TIPO_ROCA || strcmp(nodo->nombre, "Asteroide") == 0) return AMARILLO; // Asteroide en amarillo
+    if (nodo->tipo == TIPO_AGUA) return AZUL;   // Agua en azul
+    if (nodo->tipo == TIPO_FUEGO) return ROJO;  // Fuego en rojo
+    return VERDE;                               // Cualquier otro tipo en verde
+}
+
 string colorNodo(Nodo* nodo) {
     if (nodo == NULL) return string("(NULL)"); // Si el nodo es nulo, retorna la cadena "(NULL)"
-    if (nodo->tipo == "Roca" || nodo->nombre == "Asteroide")
-        return string(AMARILLO) + nodo->nombre + RESET; // Si es Asteroide, color amarillo
-    if (nodo->tipo == "Agua")
-        return string(AZUL) + nodo->nombre + RESET;       // Si es Agua, color azul
-    if (nodo->tipo == "Fuego")
-        return string(ROJO) + nodo->nombre + RESET;       // Si es Fuego, color rojo
-    return string(VERDE) + nodo->nombre + RESET;         // Para cualquier otro tipo, color verde
+    return string(codigoColor(nodo)) + nodo->nombre + RESET; // Nombre rodeado por su color y el reinicio
 }
 
 // --------------------------------------
-// ÁRBOL GENEALÓGICO
+// SALIDA CON BÚFER GRANDE
 // --------------------------------------
-struct Arbol {
-    Nodo* raiz;  // El nodo raíz del árbol (siempre "Asteroide")
+// Los volcados grandes (generaciones, recorridos) no pasan por operator<< campo a campo:
+// se arma el texto en un búfer de 1MB y se escribe al destino en bloques grandes.
+enum FormatoSalida { FORMATO_PLANO, FORMATO_ANSI, FORMATO_TSV };
+enum FormatoExportacion { EXPORTAR_DOT, EXPORTAR_NDJSON, EXPORTAR_CSV }; // Formatos para otros programas (ver Arbol::exportar)
+const string TEXTO_EXPORTACION[] = { "DOT", "NDJSON", "CSV" };
 
-    // Constructor del árbol: se ejecuta al crear un objeto Arbol
-    Arbol() {
-        raiz = new Nodo("Asteroide", "Roca", "None", "Vivo", NULL); // Crea el nodo raíz (sin padre)
-        raiz->izquierda = new Nodo("Agua", "Agua", "None", "Muerto", raiz); // Crea el hijo izquierdo inicial
-        raiz->derecha   = new Nodo("Fuego", "Fuego", "None", "Muerto", raiz); // Crea el hijo derecho inicial
+struct Salida {
+    static const size_t TAM = 1 << 20; // 1MB por bloque escrito
+    ostream& destino;                  // A dónde van los bloques (cout, archivo, BufferNulo...)
+    vector<char> buf;                  // Búfer prestado del hilo (se reutiliza entre volcados)
+    size_t usado;                      // Bytes ocupados en 'buf'
+
+    explicit Salida(ostream& d) : destino(d), usado(0) {
+        buf.swap(reservado());              // Toma el búfer del hilo: sin pedir memoria en cada volcado
+        if (buf.size() < TAM) buf.resize(TAM);
+    }
+    ~Salida() {
+        vaciar();
+        buf.swap(reservado()); // Devuelve el búfer para el siguiente volcado
     }
+    Salida(const Salida&) = delete;
+    Salida& operator=(const Salida&) = delete;
 
-    // Función para buscar un nodo por su nombre utilizando un recorrido por niveles (BFS)
-    Nodo* buscar(const string& nombre) {
-        if (raiz == NULL) return NULL; // Si el árbol está vacío, retorna NULL
-        queue<Nodo*> q;  // Declara una cola de punteros a Nodo para BFS (Breadth-First Search)
-        q.push(raiz);    // Inserta el nodo raíz para comenzar el recorrido
-        while (!q.empty()) {   // Repite mientras la cola no esté vacía
-            Nodo* act = q.front();  // Obtiene el nodo al frente de la cola
-            q.pop();             // Elimina el nodo del frente de la cola
-            if (act->nombre == nombre) return act; // Si el nombre coincide, retorna el nodo encontrado
-            if (act->izquierda) q.push(act->izquierda); // Si tiene hijo izquierdo, lo agrega a la cola
-            if (act->derecha) q.push(act->derecha);      // Si tiene hijo derecho, lo agrega a la cola
-        }
-        return NULL; // Si el bucle termina sin encontrar el nodo, retorna NULL
+    static vector<char>& reservado() { static thread_local vector<char> b; return b; }
+
+    void vaciar() { // Escribe lo acumulado en una sola llamada
+        if (usado) { destino.write(&buf[0], (streamsize)usado); usado = 0; }
     }
 
-    // Función que devuelve una lista (vector) de todos los nodos que pueden tener al menos un hijo más (menos de 2 hijos)
-    vector<Nodo*> padresDisponibles() {
-        vector<Nodo*> lista; // Vector para almacenar los nodos disponibles
-        queue<Nodo*> q;       // Cola para BFS
-        q.push(raiz);         // Inicia el BFS desde la raíz
-        while(!q.empty()) {
-            Nodo* act = q.front(); q.pop(); // Saca el nodo actual de la cola
-            if (act->hijos() < 2) lista.push_back(act); // Si tiene 0 o 1 hijo, es un padre disponible, se añade a la lista
-            if (act->izquierda) q.push(act->izquierda); // Agrega hijo izquierdo a la cola para su posterior revisión
-            if (act->derecha) q.push(act->derecha);      // Agrega hijo derecho a la cola
+    void texto(const char* t, size_t n) {
+        if (usado + n > buf.size()) {
+            vaciar();
+            if (n > buf.size()) { destino.write(t, (streamsize)n); return; } // Texto más grande que el búfer
         }
-        return lista; // Devuelve el vector con los padres disponibles
+        memcpy(&buf[usado], t, n);
+        usado += n;
     }
+    void texto(const char* t) { texto(t, strlen(t)); }
+    void texto(const string& t) { texto(t.data(), t.size()); }
 
-    // Función que pide al usuario seleccionar el tipo ("Agua" o "Fuego") y lo retorna
-    string elegirTipo() {
-        int op; // Variable para almacenar la opción del menú
-        cout << "\nTipo:\n1. Agua\n2. Fuego\nOpcion: ";
-        cin >> op;           // Lee la opción ingresada por el usuario
-        while (op < 1 || op > 2) { // Bucle de validación para asegurar que la opción es 1 o 2
-            cout << "Opcion invalida. Intente de nuevo: ";
-            cin >> op;
-        }
-        return (op == 1 ? "Agua" : "Fuego"); // Retorna "Agua" si es 1, o "Fuego" si es 2
+    void caracter(char c) {
+        if (usado == buf.size()) vaciar();
+        buf[usado++] = c;
     }
 
-    // Función que pide al usuario seleccionar el género ("Hombre" o "Mujer") y lo retorna
-    string elegirGenero() {
-        int op;
-        cout << "\nGenero:\n1. Hombre\n2. Mujer\nOpcion: ";
-        cin >> op;
-        while (op < 1 || op > 2) {
-            cout << "Opcion invalida. Intente de nuevo: ";
-            cin >> op;
-        }
-        return (op == 1 ? "Hombre" : "Mujer");
+    void entero(long long v) { // Conversión propia, sin locale ni formato de iostream
+        char tmp[24];
+        int i = sizeof(tmp);
+        unsigned long long u = v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+        do { tmp[--i] = (char)('0' + u % 10); u /= 10; } while (u);
+        if (v < 0) tmp[--i] = '-';
+        texto(tmp + i, sizeof(tmp) - i);
     }
 
-    // Función que pide al usuario seleccionar el estado ("Vivo" o "Muerto") y lo retorna
-    string elegirEstado() {
-        int op;
-        cout << "\nEstado:\n1. Vivo\n2. Muerto\nOpcion: ";
-        cin >> op;
-        while (op < 1 || op > 2) {
-            cout << "Opcion invalida. Intente de nuevo: ";
-            cin >> op;
+    void entreComillas(const char* t, size_t n) { // Texto entre comillas con '"', '\\' y los de control escapados (JSON y DOT)
+        caracter('"');
+        size_t limpio = 0; // Casi siempre no hay nada que escapar: ese tramo se copia de una vez
+        while (limpio < n && (unsigned char)t[limpio] >= 0x20 && t[limpio] != '"' && t[limpio] != '\\') limpio++;
+        texto(t, limpio);
+        for (size_t i = limpio; i < n; i++) {
+            unsigned char c = (unsigned char)t[i];
+            if (c == '"' || c == '\\') { caracter('\\'); caracter((char)c); }
+            else if (c < 0x20) { char u[8]; snprintf(u, sizeof(u), "\\u%04x", c); texto(u); }
+            else caracter((char)c);
         }
-        return (op == 1 ? "Vivo" : "Muerto");
+        caracter('"');
     }
 
-    // Función principal para insertar un nuevo nodo en el árbol
-    void insertar() {
-        string nombre; // Variable para el nombre del nuevo personaje
-        cout << "\n=== Nueva insercion ===\n";
-        cout << "Nombre: ";
-        cin >> nombre;   // Pide y lee el nombre
-
-        if (buscar(nombre)) {   // Llama a buscar para verificar si el nombre ya existe
-            cout << "ERROR: Ya existe un personaje con ese nombre.\n";
-            return; // Termina la función si el nombre ya está en uso
+    void nombre(Nodo* n, FormatoSalida formato) { // Nombre del nodo, con color si el formato es ANSI
+        if (formato == FORMATO_ANSI) {
+            texto(codigoColor(n)); texto(n->nombre, n->largo); texto(RESET);
+        } else {
+            texto(n->nombre, n->largo);
         }
+    }
+};
 
-        string tipo = elegirTipo();       // Pide y obtiene el tipo del nuevo nodo
-        string genero = elegirGenero(); // Pide y obtiene el género
-        string estado = elegirEstado(); // Pide y obtiene el estado
+// --------------------------------------
+// MOTOR DE RECORRIDOS ITERATIVOS (con visitantes)
+// --------------------------------------
+enum OrdenRecorrido { PREORDEN, INORDEN, POSTORDEN };
 
-        vector<Nodo*> disponibles = padresDisponibles(); // Obtiene la lista de nodos que pueden ser padres
-        if ((int)disponibles.size() == 0) {             // Verifica si la lista está vacía
-            cout << "No hay padres disponibles.\n";
-            return; // Termina si no hay nodos con menos de 2 hijos
+// Recorre el subárbol de 'inicio' en el orden indicado y llama a visitar(nodo) con cada nodo.
+// No usa recursión ni pila: avanza con los punteros al padre recordando desde dónde llegó a cada
+// nodo, así que funciona en árboles de cualquier profundidad y no pide memoria.
+// Con 'nivelMaximo' no baja de esa generación (los nodos más profundos ni se visitan ni se recorren).
+// Al volver de un hijo se pregunta si era el derecho y no si era el izquierdo: si un lector está en
+// una hoja que el escritor acaba de quitar, volver de la izquierda se reconoce igual y no se salta
+// el subárbol derecho. Si la quitada era la derecha se toma como vuelta de la izquierda: se baja a
+// lo que haya ahora a la derecha (nada o un nodo nuevo) y en INORDEN el padre puede verse dos veces.
+template <class Visitante>
+void recorrer(Nodo* inicio, OrdenRecorrido orden, Visitante visitar, int nivelMaximo = INT_MAX) {
+    Nodo* actual = inicio;
+    Nodo* previo = inicio ? inicio->padre : NULL; // Se "llega" a 'inicio' desde arriba
+    while (actual) {
+        Nodo* siguiente;
+        bool bajar = actual->profundidad < nivelMaximo; // Sus hijos están dentro del límite
+        if (previo == actual->padre) {            // Se bajó a este nodo por primera vez
+            if (orden == PREORDEN) visitar(actual);
+            if (bajar && actual->izquierda) siguiente = actual->izquierda;
+            else {
+                if (orden == INORDEN) visitar(actual);
+                siguiente = bajar ? (Nodo*)actual->derecha : NULL;
+            }
+        } else if (previo == actual->derecha) {   // Se volvió del subárbol derecho
+            siguiente = NULL;
+        } else {                                  // Se volvió del subárbol izquierdo
+            if (orden == INORDEN) visitar(actual);
+            siguiente = actual->derecha;
         }
-
-        // Muestra la lista de padres disponibles al usuario
-        cout << "\nSeleccione padre:\n";
-        for (int i = 0; i < (int)disponibles.size(); i++) {
-            cout << (i+1) << ". " << disponibles[i]->nombre  // Imprime la opción numerada y el nombre del padre
-                 << " (hijos: " << disponibles[i]->hijos() << ")\n"; // Muestra la cantidad actual de hijos del potencial padre
+        if (siguiente == NULL) {                  // No hay más que bajar: se sube al padre
+            if (orden == POSTORDEN) visitar(actual);
+            siguiente = (actual == inicio) ? NULL : actual->padre; // El recorrido termina al salir de 'inicio'
         }
+        previo = actual;
+        actual = siguiente;
+    }
+}
 
-        int op; // Opción para seleccionar el padre
-        cin >> op;
-        if (op < 1 || op > (int)disponibles.size()) {  // Valida que la opción esté dentro del rango
-            cout << "Opcion invalida.\n";
-            return;
-        }
+// --------------------------------------
+// POOL DE NODOS (reserva por bloques con lista de libres)
+// --------------------------------------
+// Reserva los nodos en bloques contiguos en lugar de un 'new' por nodo. Las casillas de los nodos
+// eliminados se reutilizan y cada nodo tiene un índice de 32 bits (id) para enlazarlo sin punteros.
+struct PoolNodos {
+    static const unsigned int NODOS_POR_BLOQUE = 1024;  // Nodos por bloque (potencia de 2)
+    static const unsigned int BITS_BLOQUE = 10;         // log2(NODOS_POR_BLOQUE)
+    static const unsigned int NINGUNO = 0xFFFFFFFFu;    // Marca de "no hay casilla libre"
 
-        Nodo* padreSel = disponibles[op-1]; // Obtiene el puntero al nodo padre seleccionado (usando índice op-1)
-        Nodo* nuevo = new Nodo(nombre, tipo, genero, estado, padreSel); // Crea el nuevo nodo en memoria dinámica
+    vector<Nodo*> bloques; // Bloques de memoria cruda, cada uno con NODOS_POR_BLOQUE casillas
+    unsigned int usadas;   // Casillas entregadas alguna vez (las siguientes están sin estrenar)
+    unsigned int libre;    // Primera casilla de la lista de libres (el siguiente se guarda dentro de la casilla)
+    atomic<unsigned int> vivos; // Cantidad de nodos en uso (los lectores lo usan como estimación)
 
-        if (padreSel->izquierda == NULL) padreSel->izquierda = nuevo; // Si el hijo izquierdo está libre, asigna el nuevo nodo como izquierdo
-        else padreSel->derecha = nuevo; // Si no, asigna el nuevo nodo como hijo derecho
+    PoolNodos() {
+        usadas = 0;
+        libre = NINGUNO;
+        vivos = 0;
+    }
 
-        cout << "Insertado correctamente bajo el padre: " << padreSel->nombre << "\n"; // Confirma la inserción
+    ~PoolNodos() {
+        reiniciar();
     }
 
-    // Función para eliminar un nodo del árbol
-    void eliminar() {
-        string nombre;
-        cout << "\nNombre del personaje a eliminar: ";
-        cin >> nombre; // Pide el nombre a eliminar
+    // Convierte un índice de 32 bits en el puntero al nodo
+    Nodo* nodo(unsigned int id) const {
+        return bloques[id >> BITS_BLOQUE] + (id & (NODOS_POR_BLOQUE - 1));
+    }
 
-        Nodo* objetivo = buscar(nombre); // Busca el nodo por nombre
-        if (!objetivo) { // Si el resultado de buscar es NULL
-            cout << "No existe ese personaje.\n";
-            return; // Termina si no se encuentra
+    // Reserva una casilla y construye el nodo dentro de ella
+    Nodo* crear(const char* nombre, unsigned int largo, Tipo tipo, Genero genero, Estado estado, Nodo* padre) {
+        unsigned int id;
+        if (libre != NINGUNO) {                 // Primero reutiliza una casilla liberada
+            id = libre;
+            libre = *(unsigned int*)nodo(id);   // La casilla libre guarda el índice de la siguiente
+        } else {
+            if ((usadas >> BITS_BLOQUE) == bloques.size()) // Se acabaron las casillas: pide otro bloque
+                bloques.push_back((Nodo*)::operator new(sizeof(Nodo) * NODOS_POR_BLOQUE));
+            id = usadas++;
         }
+        Nodo* nuevo = new (nodo(id)) Nodo(nombre, largo, tipo, genero, estado, padre); // Construye el nodo en la casilla ("placement new")
+        nuevo->id = id;
+        nuevo->salto = padre ? saltoHijo(padre) : id; // La raíz salta a sí misma
+        vivos.store(vivos.load(memory_order_relaxed) + 1, memory_order_relaxed); // Solo el escritor lo cambia
+        return nuevo;
+    }
 
-        if (objetivo == raiz) { // Comprueba si el nodo es la raíz
-            cout << "ERROR: No puedes eliminar la raiz (Asteroide).\n";
-            return;
-        }
+    // Puntero de salto "binario sesgado" para un hijo nuevo de 'padre': si los dos saltos del padre
+    // miden lo mismo, el hijo los une en uno del doble; si no, salta al padre. Así cualquier
+    // ancestro se alcanza en O(log n) pasos guardando un solo id por nodo. Como los nodos solo se
+    // agregan y quitan como hojas, los saltos ya calculados nunca cambian.
+    unsigned int saltoHijo(Nodo* padre) const {
+        Nodo* j = nodo(padre->salto);
+        Nodo* jj = nodo(j->salto);
+        if (padre->profundidad - j->profundidad == j->profundidad - jj->profundidad) return j->salto;
+        return padre->id;
+    }
 
-        if (objetivo->hijos() > 0) { // Comprueba si el nodo tiene hijos
-            cout << "ERROR: No se puede eliminar, tiene hijos.\n";
-            return;
-        }
+    // Destruye el nodo y devuelve su casilla a la lista de libres
+    void liberar(Nodo* n) {
+        unsigned int id = n->id;
+        n->~Nodo();
+        *(unsigned int*)n = libre; // Encadena la casilla al principio de la lista de libres
+        libre = id;
+        vivos.store(vivos.load(memory_order_relaxed) - 1, memory_order_relaxed);
+    }
 
-        if (objetivo->edadActual() < 60) { // Comprueba si tiene al menos 60 "años"
-            cout << "ERROR: Solo puede eliminarse si tiene mas de 60 anios.\n";
-            return;
-        }
+    // Devuelve todos los bloques de una vez. No llama a los destructores: si Nodo los necesita,
+    // el dueño debe destruir antes los nodos vivos. Cuesta O(cantidad de bloques).
+    void reiniciar() {
+        for (size_t i = 0; i < bloques.size(); i++) ::operator delete(bloques[i]);
+        bloques.clear();
+        usadas = 0;
+        libre = NINGUNO;
+        vivos = 0;
+    }
+};
 
-        // Desconectamos nodo del padre
-        if (objetivo->padre->izquierda == objetivo) // Si el objetivo es el hijo izquierdo de su padre
-            objetivo->padre->izquierda = NULL; // El padre apunta a NULL en su izquierda
-        else // Si es el hijo derecho
-            objetivo->padre->derecha = NULL; // El padre apunta a NULL en su derecha
+// --------------------------------------
+// ÉPOCAS (lectores sin cerrojos y liberación diferida)
+// --------------------------------------
+// Los hilos lectores no toman cerrojos: al empezar anuncian la época global en su ranura y al
+// terminar la ponen en 0. El escritor no libera enseguida lo que quita (nodos, tablas viejas del
+// índice): lo anota con la época del momento y lo libera cuando ningún lector activo anunció una
+// época igual o anterior, es decir, cuando ya nadie puede tener un puntero a eso.
+// Hoy solo el benchmark lee desde varios hilos (medirLectoresConcurrentes): el menú, el modo por
+// lotes y el servicio usan un único hilo; para ellos una guardia son dos escrituras en la ranura
+// propia y una barrera, sin competir con nadie.
+struct Epocas {
+    static const int MAX_LECTORES = 256; // Hilos lectores simultáneos como máximo
 
-        delete objetivo; // Libera la memoria ocupada por el nodo
-        cout << "Eliminado exitosamente.\n";
+    struct Ranura {
+        atomic<unsigned long long> epoca; // 0 = el hilo no está leyendo
+        atomic<bool> ocupada;             // La ranura pertenece a algún hilo
+        char relleno[64 - sizeof(atomic<unsigned long long>) - sizeof(atomic<bool>)]; // Una ranura por línea de caché
+    };
+
+    atomic<unsigned long long> global; // Época actual (empieza en 1)
+    atomic<int> ranurasUsadas;         // Ranuras entregadas alguna vez (la recolección solo mira estas)
+    Ranura ranuras[MAX_LECTORES];
+
+    Epocas() : global(1), ranurasUsadas(0) {
+        for (int i = 0; i < MAX_LECTORES; i++) { ranuras[i].epoca.store(0); ranuras[i].ocupada.store(false); }
     }
 
-    // Función para mostrar el árbol por niveles o generaciones (utiliza BFS)
-    void mostrarGeneraciones() {
-        cout << "\n=== ARBOL POR GENERACIONES ===\n";
-        queue< pair<Nodo*, int> > q;  // Cola de pares: puntero a Nodo y su nivel de profundidad
-        q.push(pair<Nodo*, int>(raiz, 0)); // Inserta la raíz con nivel 0
-        int nivelActual = -1; // Variable para rastrear el nivel que se está imprimiendo
-        while(!q.empty()) {
-            pair<Nodo*, int> act = q.front(); q.pop(); // Saca el primer elemento de la cola
-            Nodo* nodo = act.first; // Obtiene el puntero al nodo
-            int nivel = act.second; // Obtiene el nivel del nodo
-            if (nivel != nivelActual) {  // Comprueba si se ha cambiado a una nueva generación
-                nivelActual = nivel; // Actualiza el nivel actual
-                cout << "\n--- GENERACION " << nivel << " ---\n"; // Imprime el encabezado de la nueva generación
+    int tomarRanura() { // Busca una ranura libre para el hilo que la pide
+        for (int i = 0; i < MAX_LECTORES; i++) {
+            bool libre = false;
+            if (ranuras[i].ocupada.compare_exchange_strong(libre, true)) {
+                int usadas = ranurasUsadas.load();
+                while (usadas <= i && !ranurasUsadas.compare_exchange_weak(usadas, i + 1)) {}
+                return i;
             }
-            cout << "Nombre: " << nodo->nombre
-                 << " | Tipo: " << nodo->tipo
-                 << " | Genero: " << nodo->genero
-                 << " | Estado: " << nodo->estado
-                 << " | Padre: " << (nodo->padre ? nodo->padre->nombre : "Ninguno") // Muestra el nombre del padre o "Ninguno"
-                 << " | Hijos: " << nodo->hijos()
-                 << " | Edad: " << nodo->edadActual()
-                 << "\n";
-            if (nodo->izquierda) q.push(pair<Nodo*, int>(nodo->izquierda, nivel+1)); // Si hay hijo izquierdo, se agrega a la cola con nivel incrementado
-            if (nodo->derecha)   q.push(pair<Nodo*, int>(nodo->derecha, nivel+1));    // Si hay hijo derecho, se agrega a la cola con nivel incrementado
         }
+        fprintf(stderr, "Demasiados hilos lectores (maximo %d)\n", MAX_LECTORES);
+        abort();
     }
 
-    // Funciones de recorrido clásico del árbol (recursivos)
-    void recorridoPreorden(Nodo* nodo) {  // Recorrido: Nodo - Izquierda - Derecha
-        if (!nodo) return;              // Caso base de la recursión: si el nodo es nulo, termina
-        cout << nodo->nombre << " ";    // Procesa/visita el nodo (imprime el nombre)
-        recorridoPreorden(nodo->izquierda); // Llama recursivamente para el subárbol izquierdo
-        recorridoPreorden(nodo->derecha);   // Llama recursivamente para el subárbol derecho
-    }
+    void soltarRanura(int i) { ranuras[i].ocupada.store(false); }
 
-    void recorridoInorden(Nodo* nodo) {   // Recorrido: Izquierda - Nodo - Derecha
-        if (!nodo) return;
-        recorridoInorden(nodo->izquierda);
-        cout << nodo->nombre << " ";
-        recorridoInorden(nodo->derecha);
+    // Época más vieja entre los lectores activos (ULLONG_MAX si no hay ninguno)
+    unsigned long long minimaActiva() {
+        atomic_thread_fence(memory_order_seq_cst); // Lo que el escritor quitó antes ya es visible para quien empiece después
+        unsigned long long minima = ULLONG_MAX;
+        int usadas = ranurasUsadas.load();
+        for (int i = 0; i < usadas; i++) {
+            unsigned long long e = ranuras[i].epoca.load();
+            if (e != 0 && e < minima) minima = e;
+        }
+        return minima;
     }
+};
+
+Epocas epocas; // Un solo dominio de épocas para todos los árboles
+
+// La ranura de cada hilo se pide la primera vez que lee y se devuelve cuando el hilo termina
+struct RanuraDeHilo {
+    int indice;
+    RanuraDeHilo() : indice(epocas.tomarRanura()) {}
+    ~RanuraDeHilo() { epocas.soltarRanura(indice); }
+};
 
-    void recorridoPostorden(Nodo* nodo) { // Recorrido: Izquierda - Derecha - Nodo
-        if (!nodo) return;
-        recorridoPostorden(nodo->izquierda);
-        recorridoPostorden(nodo->derecha);
-        cout << nodo->nombre << " ";
+// Protege una lectura: mientras exista, nada de lo que el lector pueda alcanzar se libera.
+// Se puede anidar; solo la guardia de afuera anuncia la época.
+struct GuardiaLectura {
+    Epocas::Ranura* ranura;
+    bool anidada;
+
+    GuardiaLectura() {
+        static thread_local RanuraDeHilo propia;
+        ranura = &epocas.ranuras[propia.indice];
+        anidada = ranura->epoca.load(memory_order_relaxed) != 0;
+        if (!anidada) {
+            ranura->epoca.store(epocas.global.load());
+            atomic_thread_fence(memory_order_seq_cst); // El anuncio se ve antes que cualquier lectura del árbol
+        }
     }
+    ~GuardiaLectura() {
+        if (!anidada) ranura->epoca.store(0, memory_order_release);
+    }
+    GuardiaLectura(const GuardiaLectura&) = delete;
+    GuardiaLectura& operator=(const GuardiaLectura&) = delete;
+};
 
-    void preorden()  { recorridoPreorden(raiz); cout << "\n"; } // Función de envoltura: inicia el preorden desde la raíz
-    void inorden()   { recorridoInorden(raiz);  cout << "\n"; } // Función de envoltura: inicia el inorden desde la raíz
-    void postorden() { recorridoPostorden(raiz); cout << "\n"; } // Función de envoltura: inicia el postorden desde la raíz
+// Lista del escritor con lo que espera a que los lectores terminen para liberarse
+struct ListaRetiro {
+    static const size_t LOTE = 64; // Cada cuántos retiros se intenta liberar
 
-    // ---------------------------
-    // ÁRBOL VERTICAL CENTRADO
-    // ---------------------------
-    struct NodoPos {   // Estructura auxiliar para guardar la posición de impresión de un nodo/rama
-        int x;         // Posición horizontal (columna)
-        int y;         // Nivel vertical (fila)
-        string texto;  // El texto (nombre coloreado o símbolo de rama) a imprimir
+    struct Pendiente {
+        unsigned long long epoca;         // Época en la que se quitó
+        void (*liberar)(void*, void*);    // Cómo liberarlo: liberar(dueno, dato)
+        void* dueno;
+        void* dato;
     };
+    vector<Pendiente> pendientes;
+
+    ListaRetiro() {}
+    ~ListaRetiro() { liberarTodo(); }
+    ListaRetiro(const ListaRetiro&) = delete;
+    ListaRetiro& operator=(const ListaRetiro&) = delete;
 
-    // Función recursiva para calcular las posiciones y textos de todos los elementos del árbol
-    void buildTreeLines(Nodo* nodo, int x, int y, vector< vector<NodoPos> >& lines) {
-        if (!nodo) return;   // Caso base: si el nodo es nulo, termina la recursión
+    void retirar(void (*liberar)(void*, void*), void* dueno, void* dato) {
+        Pendiente p = { epocas.global.load(), liberar, dueno, dato };
+        pendientes.push_back(p);
+        if (pendientes.size() >= LOTE) recolectar();
+    }
+
+    // Avanza la época y libera lo que ningún lector activo puede estar viendo
+    void recolectar() {
+        epocas.global.fetch_add(1); // Los lectores que empiecen desde ahora ya no ven lo retirado
+        unsigned long long minima = epocas.minimaActiva();
+        size_t quedan = 0;
+        for (size_t i = 0; i < pendientes.size(); i++) {
+            if (pendientes[i].epoca < minima) pendientes[i].liberar(pendientes[i].dueno, pendientes[i].dato);
+            else pendientes[quedan++] = pendientes[i];
+        }
+        pendientes.resize(quedan);
+    }
 
-        while ((int)lines.size() <= y)   // Asegura que el vector 'lines' tenga un vector para el nivel 'y'
-            lines.push_back(vector<NodoPos>()); // Si no existe, agrega un nuevo nivel
+    // Libera todo sin esperar (solo cuando se sabe que no hay lectores)
+    void liberarTodo() {
+        for (size_t i = 0; i < pendientes.size(); i++) pendientes[i].liberar(pendientes[i].dueno, pendientes[i].dato);
+        pendientes.clear();
+    }
+};
 
-        NodoPos np;          // Crea un objeto para la posición del nodo actual
-        np.x = x;            // Asigna la posición horizontal
-        np.y = y;            // Asigna el nivel vertical
-        np.texto = colorNodo(nodo); // Obtiene y asigna el nombre del nodo con su color ANSI
-        lines[y].push_back(np);      // Agrega este NodoPos a la lista de elementos en el nivel 'y'
+// --------------------------------------
+// ÍNDICE HASH DE NOMBRES (nombre -> Nodo*)
+// --------------------------------------
+// Función hash FNV-1a de 32 bits para los nombres
+unsigned int hashNombre(const char* s, size_t largo) {
+    unsigned int h = 2166136261u;             // Valor inicial (offset basis) de FNV-1a
+    for (size_t i = 0; i < largo; i++) {
+        h ^= (unsigned char)s[i];             // Mezcla el siguiente carácter
+        h *= 16777619u;                       // Multiplica por el primo de FNV
+    }
+    return h;
+}
 
-        int gap = 6; // Define la separación horizontal base entre el padre y sus hijos
+// Tabla hash de direccionamiento abierto (sondeo lineal) que guarda el hash ya calculado de cada nombre
+struct IndiceNombres {
+    struct Entrada {
+        atomic<unsigned int> hash; // Hash precalculado del nombre (evita recalcularlo al crecer y filtra comparaciones)
+        atomic<Nodo*> nodo;        // Nodo guardado en la casilla (NULL = vacía, BORRADO() = lápida)
+    };
 
-        // Procesamiento del Subárbol izquierdo
-        if (nodo->izquierda) {
-            while ((int)lines.size() <= y + 1) lines.push_back(vector<NodoPos>()); // Asegura espacio para la línea de conexión
-            NodoPos branch;    // Crea un objeto para el símbolo de rama izquierda "/"
-            branch.x = x - gap; // Posición de la rama izquierda (un poco a la izquierda del padre)
-            branch.y = y + 1; // Nivel de la rama (debajo del padre)
-            branch.texto = "/"; // El símbolo de rama
-            lines[y + 1].push_back(branch);
+    // Tabla de casillas con su tamaño en un solo bloque: se publica (y se retira) de una vez
+    struct Tabla {
+        size_t mascara; // Cantidad de casillas - 1 (siempre potencia de 2)
+        Entrada* casillas() { return (Entrada*)(this + 1); }
 
-            // Llamada recursiva para el hijo izquierdo, ajustando la posición horizontal
-            buildTreeLines(nodo->izquierda, x - gap - (int)colorNodo(nodo->izquierda).length()/2, y + 2, lines); 
+        static Tabla* crear(size_t capacidad) {
+            Tabla* t = (Tabla*)::operator new(sizeof(Tabla) + capacidad * sizeof(Entrada));
+            t->mascara = capacidad - 1;
+            Entrada* c = t->casillas();
+            for (size_t i = 0; i < capacidad; i++) { c[i].hash.store(0, memory_order_relaxed); c[i].nodo.store(NULL, memory_order_relaxed); }
+            return t;
         }
+        static void liberar(void*, void* t) { ::operator delete(t); }
+    };
 
-        // Procesamiento del Subárbol derecho
-        if (nodo->derecha) {
-            while ((int)lines.size() <= y + 1) lines.push_back(vector<NodoPos>()); // Asegura espacio para la línea de conexión
-            NodoPos branch;    // Crea un objeto para el símbolo de rama derecha "\"
-            branch.x = x + gap; // Posición de la rama derecha (un poco a la derecha del padre)
-            branch.y = y + 1;
-            branch.texto = "\\";
-            lines[y + 1].push_back(branch);
+    atomic<Tabla*> tabla;   // Tabla actual (los lectores la toman con una carga "acquire")
+    size_t vivos;           // Cantidad de nodos guardados
+    size_t ocupadas;        // Casillas no vacías (vivos + lápidas)
+    ListaRetiro* retiro;    // Dónde dejar las tablas viejas (NULL: se liberan enseguida)
 
-            // Llamada recursiva para el hijo derecho, ajustando la posición horizontal
-            buildTreeLines(nodo->derecha, x + gap + (int)colorNodo(nodo).length()/2, y + 2, lines);
-        }
+    IndiceNombres() {
+        retiro = NULL;
+        tabla.store(Tabla::crear(16)); // Capacidad inicial de 16 casillas
+        vivos = 0;
+        ocupadas = 0;
     }
+    ~IndiceNombres() { Tabla::liberar(NULL, tabla.load()); }
+    IndiceNombres(const IndiceNombres&) = delete;
+    IndiceNombres& operator=(const IndiceNombres&) = delete;
 
-    // Función para mostrar el árbol como un diagrama vertical centrado y coloreado
-    void mostrarArbolVertical() {
-        cout << "\n=== ARBOL VERTICAL CENTRADO Y COLOREADO ===\n\n";
+    // Vuelve a la tabla inicial (solo sin lectores activos)
+    void reiniciar() {
+        Tabla::liberar(NULL, tabla.load());
+        tabla.store(Tabla::crear(16));
+        vivos = 0;
+        ocupadas = 0;
+    }
 
-        vector< vector<NodoPos> > lines; // Vector de vectores: cada vector interno representa un nivel/línea de impresión
+    // Marca especial para casillas borradas (lápida): no corta la cadena de sondeo
+    static Nodo* BORRADO() { static char marca; return (Nodo*)&marca; }
 
-        int width = 80;          // Ancho de impresión (número de caracteres)
-        int rootX = width / 2;   // Calcula la posición horizontal central para la raíz
+    // Busca un nodo por nombre en O(1) promedio. Es seguro desde un hilo lector (con GuardiaLectura)
+    // mientras el escritor modifica el índice: a lo sumo no ve un cambio que está ocurriendo.
+    Nodo* buscar(const char* nombre, size_t largo) const {
+        unsigned int h = hashNombre(nombre, largo);
+        Tabla* t = tabla.load(memory_order_acquire);
+        Entrada* c = t->casillas();
+        for (size_t i = h & t->mascara; ; i = (i + 1) & t->mascara) {
+            Nodo* n = c[i].nodo.load(memory_order_acquire);
+            if (n == NULL) return NULL; // Casilla vacía: el nombre no existe
+            if (n != BORRADO() && c[i].hash.load(memory_order_relaxed) == h && n->tieneNombre(nombre, largo)) return n;
+        }
+    }
 
-        buildTreeLines(raiz, rootX, 0, lines); // Inicia la construcción de las posiciones de impresión
+    // Agrega un nodo al índice (se asume que su nombre no está repetido)
+    void insertar(Nodo* nodo) {
+        size_t capacidad = tabla.load(memory_order_relaxed)->mascara + 1;
+        if ((ocupadas + 1) * 4 > capacidad * 3) // Mantiene el factor de carga por debajo de 3/4
+            rehash(vivos * 2 < capacidad / 2 ? capacidad : capacidad * 2); // Si sobran lápidas, solo limpia
+        colocar(tabla.load(memory_order_relaxed), hashNombre(nodo->nombre, nodo->largo), nodo);
+    }
 
-        // Bucle para iterar sobre cada nivel del árbol
-        for (int i = 0; i < (int)lines.size(); i++) {
-            string line(width * 2, ' '); // Inicializa una línea de impresión con el doble de ancho (para manejar caracteres ANSI)
-            // Bucle para iterar sobre todos los elementos (nodos o ramas) en el nivel actual
-            for (int j = 0; j < (int)lines[i].size(); j++) {
-                int pos = lines[i][j].x; // Posición horizontal del elemento
-                // Verifica que la posición esté dentro del rango de la línea
-                if (pos >= 0 && pos < (int)line.length())
-                    // Reemplaza los espacios en la línea con el texto (nombre o rama) del elemento
-                    line.replace(pos, lines[i][j].texto.length(), lines[i][j].texto); 
+    // Quita un nodo del índice dejando una lápida en su casilla
+    void quitar(Nodo* nodo) {
+        unsigned int h = hashNombre(nodo->nombre, nodo->largo);
+        Tabla* t = tabla.load(memory_order_relaxed);
+        Entrada* c = t->casillas();
+        for (size_t i = h & t->mascara; c[i].nodo.load(memory_order_relaxed) != NULL; i = (i + 1) & t->mascara) {
+            if (c[i].nodo.load(memory_order_relaxed) == nodo) {
+                c[i].nodo.store(BORRADO(), memory_order_release); // Deja la lápida para no romper otras cadenas de sondeo
+                vivos--;
+                return;
             }
-            cout << line << "\n"; // Muestra la línea completa del nivel actual
         }
-        cout << "\n";
     }
 
+    // Coloca la entrada en la primera casilla libre de su cadena de sondeo. El hash se escribe
+    // antes que el nodo, así un lector que ve el nodo también ve su hash.
+    void colocar(Tabla* t, unsigned int h, Nodo* nodo) {
+        Entrada* c = t->casillas();
+        size_t i = h & t->mascara;
+        Nodo* actual;
+        while ((actual = c[i].nodo.load(memory_order_relaxed)) != NULL && actual != BORRADO()) i = (i + 1) & t->mascara;
+        if (actual == NULL) ocupadas++; // Reutilizar una lápida no aumenta las ocupadas
+        c[i].hash.store(h, memory_order_relaxed);
+        c[i].nodo.store(nodo, memory_order_release);
+        vivos++;
+    }
+
+    // Construye una tabla nueva de 'capacidad' casillas con los hashes ya guardados, la publica
+    // y retira la vieja (los lectores que la estén usando la terminan de recorrer tranquilos)
+    void rehash(size_t capacidad) {
+        Tabla* vieja = tabla.load(memory_order_relaxed);
+        Tabla* nueva = Tabla::crear(capacidad);
+        vivos = 0;
+        ocupadas = 0;
+        Entrada* c = vieja->casillas();
+        for (size_t i = 0; i <= vieja->mascara; i++) {
+            Nodo* n = c[i].nodo.load(memory_order_relaxed);
+            if (n != NULL && n != BORRADO()) colocar(nueva, c[i].hash.load(memory_order_relaxed), n);
+        }
+        tabla.store(nueva, memory_order_release);
+        if (retiro) retiro->retirar(Tabla::liberar, NULL, vieja);
+        else Tabla::liberar(NULL, vieja);
+    }
 };
 
 // --------------------------------------
-// MAIN
+// NOMBRES EN ORDEN ALFABÉTICO (prefijos, rangos y nombres parecidos)
 // --------------------------------------
-int main() {
-    Arbol arbol; // Crea una instancia del árbol genealógico
+// Arreglo ordenado de los nodos por nombre (bytes sin signo, como memcmp), partido en bloques de
+// a lo sumo MAX_BLOQUE punteros para que insertar o quitar solo mueva un bloque. Se busca por el
+// texto directamente (búsqueda binaria sobre los bloques y dentro del bloque) y recorrerlo en orden
+// es leer arreglos contiguos. Se mantiene junto con el índice hash y responde sin tocar el árbol:
+// los nombres que empiezan con un texto, los que caen entre dos nombres y los que están a pocas
+// ediciones de uno dado. Solo lo usa el escritor.
+struct NombresOrdenados {
+    static const size_t MAX_BLOQUE = 1024; // Un bloque más grande se parte en dos mitades
+
+    // Compara dos nombres; negativo, cero o positivo como memcmp (el más corto va primero si es prefijo)
+    static int comparar(const char* a, size_t la, const char* b, size_t lb) {
+        int c = memcmp(a, b, min(la, lb));
+        if (c != 0) return c;
+        return la < lb ? -1 : (la > lb ? 1 : 0);
+    }
+
+    // Lugar de un nombre: bloque y posición dentro del bloque (bloque == bloques.size() es el final)
+    struct Posicion {
+        size_t bloque, i;
+    };
+
+    vector<vector<Nodo*> > bloques; // Ninguno vacío; todos los nombres de un bloque van antes que los del siguiente
+    size_t cantidad;
+
+    NombresOrdenados() : cantidad(0) {}
+
+    bool final(const Posicion& p) const { return p.bloque == bloques.size(); }
+    Nodo* en(const Posicion& p) const { return bloques[p.bloque][p.i]; }
+    void avanzar(Posicion& p) const {
+        if (++p.i == bloques[p.bloque].size()) { p.bloque++; p.i = 0; }
+    }
+    Posicion inicio() const { Posicion p = { 0, 0 }; return p; }
+
+    // Primer nodo para el que 'antes' es falso ('antes' debe ser verdadero en un prefijo del orden),
+    // sabiendo que no está en un bloque anterior a 'primerBloque'
+    template <class Antes>
+    Posicion primeroQueNo(Antes antes, size_t primerBloque = 0) const {
+        size_t lo = primerBloque, hi = bloques.size(); // Primer bloque cuyo último nombre ya no va antes
+        while (lo < hi) {
+            size_t medio = (lo + hi) / 2;
+            if (antes(bloques[medio].back())) lo = medio + 1;
+            else hi = medio;
+        }
+        Posicion p = { lo, 0 };
+        if (lo < bloques.size()) p.i = partition_point(bloques[lo].begin(), bloques[lo].end(), antes) - bloques[lo].begin();
+        return p;
+    }
+
+    // Primer nodo cuyo nombre es >= 'texto'
+    Posicion desde(const char* texto, size_t largo) const {
+        return primeroQueNo([&](const Nodo* n) { return comparar(n->nombre, n->largo, texto, largo) < 0; });
+    }
+
+    // Primer nodo cuyo nombre ya no empieza con 'prefijo' ni va antes que él, buscando desde el bloque de 'actual'
+    Posicion despuesDePrefijo(const char* prefijo, size_t largo, const Posicion& actual) const {
+        return primeroQueNo([&](const Nodo* n) { return memcmp(n->nombre, prefijo, min((size_t)n->largo, largo)) <= 0; }, actual.bloque);
+    }
+
+    void insertar(Nodo* n) {
+        cantidad++;
+        if (bloques.empty()) { bloques.push_back(vector<Nodo*>(1, n)); return; }
+        Posicion p = desde(n->nombre, n->largo);
+        if (final(p)) { p.bloque--; p.i = bloques[p.bloque].size(); } // Va después de todos: al final del último
+        vector<Nodo*>& b = bloques[p.bloque];
+        b.insert(b.begin() + p.i, n);
+        if (b.size() > MAX_BLOQUE) { // Se parte en dos mitades
+            vector<Nodo*> mitad(b.begin() + b.size() / 2, b.end());
+            b.resize(b.size() / 2);
+            bloques.insert(bloques.begin() + p.bloque + 1, vector<Nodo*>());
+            bloques[p.bloque + 1].swap(mitad);
+        }
+    }
+
+    void quitar(Nodo* n) {
+        Posicion p = desde(n->nombre, n->largo);
+        if (final(p) || en(p) != n) return; // No estaba
+        cantidad--;
+        vector<Nodo*>& b = bloques[p.bloque];
+        b.erase(b.begin() + p.i);
+        if (b.empty()) bloques.erase(bloques.begin() + p.bloque);
+        else if (p.bloque + 1 < bloques.size() && b.size() + bloques[p.bloque + 1].size() <= MAX_BLOQUE / 2) {
+            b.insert(b.end(), bloques[p.bloque + 1].begin(), bloques[p.bloque + 1].end()); // Junta dos bloques chicos
+            bloques.erase(bloques.begin() + p.bloque + 1);
+        }
+    }
+
+    void reiniciar() { bloques.clear(); cantidad = 0; }
+
+    // Nodos cuyo nombre empieza con 'prefijo', en orden alfabético (a lo sumo 'maximo')
+    size_t prefijo(const char* texto, size_t largo, vector<Nodo*>& salida, size_t maximo = (size_t)-1) const {
+        size_t antes = salida.size();
+        for (Posicion p = desde(texto, largo); !final(p) && salida.size() - antes < maximo; avanzar(p)) {
+            Nodo* n = en(p);
+            if (n->largo < largo || memcmp(n->nombre, texto, largo) != 0) break;
+            salida.push_back(n);
+        }
+        return salida.size() - antes;
+    }
+
+    // Nodos con nombre entre 'primero' y 'ultimo' (ambos incluidos), en orden alfabético
+    size_t rango(const char* primero, size_t lp, const char* ultimo, size_t lu, vector<Nodo*>& salida, size_t maximo = (size_t)-1) const {
+        size_t antes = salida.size();
+        for (Posicion p = desde(primero, lp); !final(p) && salida.size() - antes < maximo; avanzar(p)) {
+            Nodo* n = en(p);
+            if (comparar(n->nombre, n->largo, ultimo, lu) > 0) break;
+            salida.push_back(n);
+        }
+        return salida.size() - antes;
+    }
+
+    // Nodos a distancia de Levenshtein <= 'maximo' de 'texto' (contada en bytes), con su distancia.
+    // Recorre los nombres en orden como si fueran un trie: la fila i de la tabla de distancias
+    // depende solo de los primeros i caracteres, así que se reutilizan las filas del prefijo que
+    // comparte con el nombre anterior. Si todas las casillas de una fila pasan de 'maximo', ningún
+    // nombre con ese prefijo sirve y se saltan todos de una vez.
+    size_t parecidos(const char* texto, size_t largo, unsigned int maximo, vector<Nodo*>& salida, vector<unsigned int>& distancias) const {
+        size_t antes = salida.size();
+        size_t ancho = largo + 1;
+        vector<unsigned int> filas(ancho); // Fila i = distancias entre los primeros i bytes del nombre y cada prefijo de 'texto'
+        for (size_t j = 0; j < ancho; j++) filas[j] = (unsigned int)j;
+        Nodo* previo = NULL; // Último nombre visitado
+        size_t hechas = 0;   // Filas válidas para los primeros 'hechas' bytes de 'previo'
+        Posicion p = inicio();
+        while (!final(p)) {
+            Nodo* n = en(p);
+            size_t i = 0;
+            if (previo) {
+                size_t tope = min(hechas, (size_t)n->largo);
+                while (i < tope && previo->nombre[i] == n->nombre[i]) i++; // Filas que se pueden reutilizar
+            }
+            bool podado = false;
+            while (i < n->largo) {
+                if (filas.size() < (i + 2) * ancho) filas.resize((i + 2) * ancho);
+                const unsigned int* arriba = &filas[i * ancho];
+                unsigned int* fila = &filas[(i + 1) * ancho];
+                char c = n->nombre[i];
+                fila[0] = (unsigned int)(i + 1);
+                unsigned int minimo = fila[0];
+                for (size_t j = 1; j < ancho; j++) {
+                    unsigned int v = arriba[j - 1] + (texto[j - 1] == c ? 0 : 1); // Reemplazo (o coincidencia)
+                    v = min(v, arriba[j] + 1);   // Byte de más en el nombre
+                    v = min(v, fila[j - 1] + 1); // Byte de menos en el nombre
+                    fila[j] = v;
+                    minimo = min(minimo, v);
+                }
+                i++;
+                if (minimo > maximo) { podado = true; break; }
+            }
+            previo = n;
+            hechas = i;
+            if (podado) { p = despuesDePrefijo(n->nombre, i, p); continue; }
+            unsigned int d = filas[i * ancho + largo];
+            if (d <= maximo) { salida.push_back(n); distancias.push_back(d); }
+            avanzar(p);
+        }
+        return salida.size() - antes;
+    }
+};
+
+// --------------------------------------
+// MAPAS DE BITS COMPRIMIDOS (índices por atributo)
+// --------------------------------------
+// Conjunto de ids de 32 bits al estilo "roaring": los 16 bits altos eligen un contenedor y los 16
+// bajos se guardan dentro. Un contenedor con pocos ids (hasta 4096) es un arreglo ordenado de
+// uint16_t; con más es un mapa de 65536 bits (8 KB). Un valor raro ocupa poco y dos valores
+// comunes se cruzan palabra a palabra contando con popcount.
+
+// Cantidad de bits en 1 de una palabra
+inline int contarBits(uint64_t x) {
+#ifdef __GNUC__
+    return __builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+// Posición del bit en 1 más bajo de una palabra distinta de cero
+inline int bitMasBajo(uint64_t x) {
+#ifdef __GNUC__
+    return __builtin_ctzll(x);
+#else
+    return contarBits((x & (0 - x)) - 1);
+#endif
+}
+
+// Sin -mpopcnt, GCC cuenta bits con una rutina por software (unas 4 veces más lenta). Si el
+// procesador tiene la instrucción POPCNT, los bucles largos usan una copia compilada para ella.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(__POPCNT__)
+#define POPCNT_EN_EJECUCION
+__attribute__((target("popcnt"))) uint32_t contarPalabrasPopcnt(const uint64_t* p, uint32_t n) {
+    uint32_t total = 0;
+    for (uint32_t w = 0; w < n; w++) total += (uint32_t)__builtin_popcountll(p[w]);
+    return total;
+}
+__attribute__((target("popcnt"))) uint32_t cruzarPalabrasPopcnt(const uint64_t* a, const uint64_t* b, uint64_t* d, uint32_t n) {
+    uint32_t total = 0;
+    for (uint32_t w = 0; w < n; w++) { d[w] = a[w] & b[w]; total += (uint32_t)__builtin_popcountll(d[w]); }
+    return total;
+}
+bool detectarPopcnt() { __builtin_cpu_init(); return __builtin_cpu_supports("popcnt"); }
+const bool HAY_POPCNT = detectarPopcnt();
+#endif
+
+// Bits en 1 de 'n' palabras
+inline uint32_t contarPalabras(const uint64_t* p, uint32_t n) {
+#ifdef POPCNT_EN_EJECUCION
+    if (HAY_POPCNT) return contarPalabrasPopcnt(p, n);
+#endif
+    uint32_t total = 0;
+    for (uint32_t w = 0; w < n; w++) total += contarBits(p[w]);
+    return total;
+}
+
+// d = a AND b palabra a palabra; devuelve los bits en 1 del resultado
+inline uint32_t cruzarPalabras(const uint64_t* a, const uint64_t* b, uint64_t* d, uint32_t n) {
+#ifdef POPCNT_EN_EJECUCION
+    if (HAY_POPCNT) return cruzarPalabrasPopcnt(a, b, d, n);
+#endif
+    uint32_t total = 0;
+    for (uint32_t w = 0; w < n; w++) { d[w] = a[w] & b[w]; total += contarBits(d[w]); }
+    return total;
+}
+
+struct MapaBits {
+    static const uint32_t MAX_ARREGLO = 4096; // Más ids que esto: el contenedor pasa a mapa de bits
+    static const uint32_t PALABRAS = 1024;    // Palabras de 64 bits de un contenedor en modo mapa
+
+    struct Contenedor {
+        uint16_t alto;            // 16 bits altos de todos los ids del contenedor
+        uint32_t cantidad;        // Ids guardados
+        vector<uint16_t> valores; // Modo arreglo: 16 bits bajos, ordenados
+        vector<uint64_t> bits;    // Modo mapa: PALABRAS palabras (vacío en modo arreglo)
+
+        explicit Contenedor(uint16_t a = 0) : alto(a), cantidad(0) {}
+
+        bool esMapa() const { return !bits.empty(); }
+
+        bool contiene(uint16_t v) const {
+            if (esMapa()) return (bits[v >> 6] >> (v & 63)) & 1;
+            return binary_search(valores.begin(), valores.end(), v);
+        }
+
+        void aMapa() {
+            bits.assign(PALABRAS, 0);
+            for (size_t i = 0; i < valores.size(); i++) bits[valores[i] >> 6] |= 1ULL << (valores[i] & 63);
+            vector<uint16_t>().swap(valores);
+        }
+
+        void aArreglo() {
+            valores.clear();
+            valores.reserve(cantidad);
+            for (uint32_t w = 0; w < PALABRAS; w++)
+                for (uint64_t p = bits[w]; p; p &= p - 1)
+                    valores.push_back((uint16_t)(w * 64 + bitMasBajo(p)));
+            vector<uint64_t>().swap(bits);
+        }
+
+        // Elige el modo según la cantidad (para los resultados de las operaciones)
+        void normalizar() {
+            if (esMapa() && cantidad <= MAX_ARREGLO) aArreglo();
+            else if (!esMapa() && cantidad > MAX_ARREGLO) aMapa();
+        }
+
+        void recontar() { cantidad = contarPalabras(bits.data(), PALABRAS); }
+    };
+
+    vector<Contenedor> contenedores; // Ordenados por 'alto'; nunca hay uno vacío
+
+    // Posición del contenedor 'alto' (o donde debería insertarse)
+    size_t posicion(uint16_t alto) const {
+        size_t lo = 0, hi = contenedores.size();
+        while (lo < hi) {
+            size_t medio = (lo + hi) / 2;
+            if (contenedores[medio].alto < alto) lo = medio + 1;
+            else hi = medio;
+        }
+        return lo;
+    }
+
+    void agregar(uint32_t id) {
+        uint16_t alto = (uint16_t)(id >> 16), v = (uint16_t)id;
+        size_t i = posicion(alto);
+        if (i == contenedores.size() || contenedores[i].alto != alto)
+            contenedores.insert(contenedores.begin() + i, Contenedor(alto));
+        Contenedor& c = contenedores[i];
+        if (c.esMapa()) {
+            uint64_t& palabra = c.bits[v >> 6];
+            if (!((palabra >> (v & 63)) & 1)) { palabra |= 1ULL << (v & 63); c.cantidad++; }
+            return;
+        }
+        vector<uint16_t>::iterator it = lower_bound(c.valores.begin(), c.valores.end(), v);
+        if (it != c.valores.end() && *it == v) return;
+        c.valores.insert(it, v);
+        c.cantidad++;
+        if (c.cantidad > MAX_ARREGLO) c.aMapa();
+    }
+
+    void quitar(uint32_t id) {
+        uint16_t alto = (uint16_t)(id >> 16), v = (uint16_t)id;
+        size_t i = posicion(alto);
+        if (i == contenedores.size() || contenedores[i].alto != alto) return;
+        Contenedor& c = contenedores[i];
+        if (c.esMapa()) {
+            uint64_t& palabra = c.bits[v >> 6];
+            if (!((palabra >> (v & 63)) & 1)) return;
+            palabra &= ~(1ULL << (v & 63));
+            c.cantidad--;
+            if (c.cantidad <= MAX_ARREGLO / 2) c.aArreglo(); // Margen: no cambia de modo en cada alta y baja
+        } else {
+            vector<uint16_t>::iterator it = lower_bound(c.valores.begin(), c.valores.end(), v);
+            if (it == c.valores.end() || *it != v) return;
+            c.valores.erase(it);
+            c.cantidad--;
+        }
+        if (c.cantidad == 0) contenedores.erase(contenedores.begin() + i);
+    }
+
+    bool contiene(uint32_t id) const {
+        size_t i = posicion((uint16_t)(id >> 16));
+        return i < contenedores.size() && contenedores[i].alto == (id >> 16) && contenedores[i].contiene((uint16_t)id);
+    }
+
+    uint64_t cantidad() const {
+        uint64_t total = 0;
+        for (size_t i = 0; i < contenedores.size(); i++) total += contenedores[i].cantidad;
+        return total;
+    }
+
+    void limpiar() { contenedores.clear(); }
+
+    // Llama a visitar(id) con cada id, de menor a mayor
+    template <class Visitante>
+    void recorrer(Visitante visitar) const {
+        for (size_t i = 0; i < contenedores.size(); i++) {
+            const Contenedor& c = contenedores[i];
+            uint32_t base = (uint32_t)c.alto << 16;
+            if (!c.esMapa()) {
+                for (size_t k = 0; k < c.valores.size(); k++) visitar(base | c.valores[k]);
+                continue;
+            }
+            for (uint32_t w = 0; w < PALABRAS; w++)
+                for (uint64_t p = c.bits[w]; p; p &= p - 1)
+                    visitar(base | (w * 64 + bitMasBajo(p)));
+        }
+    }
+
+    // Operaciones entre contenedores con el mismo 'alto'. El resultado puede quedar vacío.
+    static void cruzar(const Contenedor& x, const Contenedor& y, Contenedor& r) {
+        if (!x.esMapa() && !y.esMapa()) { // Dos arreglos ordenados: se mezclan
+            r.valores.resize(min(x.valores.size(), y.valores.size()));
+            r.valores.resize(set_intersection(x.valores.begin(), x.valores.end(), y.valores.begin(), y.valores.end(), r.valores.begin()) - r.valores.begin());
+            r.cantidad = (uint32_t)r.valores.size();
+            return;
+        }
+        if (!x.esMapa() || !y.esMapa()) { // Se recorre el arreglo y se consulta el mapa
+            const Contenedor& a = x.esMapa() ? y : x;
+            const Contenedor& b = x.esMapa() ? x : y;
+            for (size_t i = 0; i < a.valores.size(); i++)
+                if (b.contiene(a.valores[i])) r.valores.push_back(a.valores[i]);
+            r.cantidad = (uint32_t)r.valores.size();
+            return;
+        }
+        r.bits.resize(PALABRAS);
+        r.cantidad = cruzarPalabras(x.bits.data(), y.bits.data(), r.bits.data(), PALABRAS);
+        r.normalizar();
+    }
+
+    static void unir(const Contenedor& x, const Contenedor& y, Contenedor& r) {
+        if (!x.esMapa() && !y.esMapa()) {
+            r.valores.resize(x.valores.size() + y.valores.size());
+            r.valores.resize(set_union(x.valores.begin(), x.valores.end(), y.valores.begin(), y.valores.end(), r.valores.begin()) - r.valores.begin());
+            r.cantidad = (uint32_t)r.valores.size();
+            r.normalizar();
+            return;
+        }
+        const Contenedor& a = x.esMapa() ? x : y; // Al menos uno es mapa
+        const Contenedor& b = (&a == &x) ? y : x;
+        r.bits = a.bits;
+        if (b.esMapa()) for (uint32_t w = 0; w < PALABRAS; w++) r.bits[w] |= b.bits[w];
+        else for (size_t i = 0; i < b.valores.size(); i++) r.bits[b.valores[i] >> 6] |= 1ULL << (b.valores[i] & 63);
+        r.recontar();
+    }
+
+    static void restar(const Contenedor& x, const Contenedor& y, Contenedor& r) {
+        if (!x.esMapa() && !y.esMapa()) {
+            r.valores.resize(x.valores.size());
+            r.valores.resize(set_difference(x.valores.begin(), x.valores.end(), y.valores.begin(), y.valores.end(), r.valores.begin()) - r.valores.begin());
+            r.cantidad = (uint32_t)r.valores.size();
+            return;
+        }
+        if (!x.esMapa()) {
+            for (size_t i = 0; i < x.valores.size(); i++)
+                if (!y.contiene(x.valores[i])) r.valores.push_back(x.valores[i]);
+            r.cantidad = (uint32_t)r.valores.size();
+            return;
+        }
+        r.bits = x.bits;
+        if (y.esMapa()) for (uint32_t w = 0; w < PALABRAS; w++) r.bits[w] &= ~y.bits[w];
+        else for (size_t i = 0; i < y.valores.size(); i++) r.bits[y.valores[i] >> 6] &= ~(1ULL << (y.valores[i] & 63));
+        r.recontar();
+        r.normalizar();
+    }
+
+    // a AND b
+    static MapaBits interseccion(const MapaBits& a, const MapaBits& b) {
+        MapaBits r;
+        size_t i = 0, j = 0;
+        while (i < a.contenedores.size() && j < b.contenedores.size()) {
+            const Contenedor& x = a.contenedores[i];
+            const Contenedor& y = b.contenedores[j];
+            if (x.alto < y.alto) i++;
+            else if (y.alto < x.alto) j++;
+            else {
+                r.contenedores.push_back(Contenedor(x.alto));
+                cruzar(x, y, r.contenedores.back());
+                if (r.contenedores.back().cantidad == 0) r.contenedores.pop_back();
+                i++; j++;
+            }
+        }
+        return r;
+    }
+
+    // a OR b
+    static MapaBits union_(const MapaBits& a, const MapaBits& b) {
+        MapaBits r;
+        size_t i = 0, j = 0;
+        while (i < a.contenedores.size() || j < b.contenedores.size()) {
+            if (j == b.contenedores.size() || (i < a.contenedores.size() && a.contenedores[i].alto < b.contenedores[j].alto))
+                r.contenedores.push_back(a.contenedores[i++]);
+            else if (i == a.contenedores.size() || b.contenedores[j].alto < a.contenedores[i].alto)
+                r.contenedores.push_back(b.contenedores[j++]);
+            else {
+                r.contenedores.push_back(Contenedor(a.contenedores[i].alto));
+                unir(a.contenedores[i++], b.contenedores[j++], r.contenedores.back());
+            }
+        }
+        return r;
+    }
+
+    // a AND NOT b
+    static MapaBits diferencia(const MapaBits& a, const MapaBits& b) {
+        MapaBits r;
+        size_t j = 0;
+        for (size_t i = 0; i < a.contenedores.size(); i++) {
+            const Contenedor& x = a.contenedores[i];
+            while (j < b.contenedores.size() && b.contenedores[j].alto < x.alto) j++;
+            if (j == b.contenedores.size() || b.contenedores[j].alto != x.alto) { r.contenedores.push_back(x); continue; }
+            r.contenedores.push_back(Contenedor(x.alto));
+            restar(x, b.contenedores[j], r.contenedores.back());
+            if (r.contenedores.back().cantidad == 0) r.contenedores.pop_back();
+        }
+        return r;
+    }
+};
+
+// Un mapa de bits por cada valor de tipo, género y estado, más el de todos los ids vivos
+// (el universo contra el que se calcula NOT). Se mantiene al insertar, eliminar y cambiar estado.
+struct IndiceAtributos {
+    MapaBits todos;
+    MapaBits porTipo[3];
+    MapaBits porGenero[3];
+    MapaBits porEstado[2];
+
+    void agregar(const Nodo* n) {
+        todos.agregar(n->id);
+        porTipo[n->tipo].agregar(n->id);
+        porGenero[n->genero].agregar(n->id);
+        porEstado[n->estado].agregar(n->id);
+    }
+
+    void quitar(const Nodo* n) {
+        todos.quitar(n->id);
+        porTipo[n->tipo].quitar(n->id);
+        porGenero[n->genero].quitar(n->id);
+        porEstado[n->estado].quitar(n->id);
+    }
+
+    // Se llama antes de cambiar n->estado
+    void cambiarEstado(const Nodo* n, Estado nuevo) {
+        porEstado[n->estado].quitar(n->id);
+        porEstado[nuevo].agregar(n->id);
+    }
+
+    void reiniciar() {
+        todos.limpiar();
+        for (int i = 0; i < 3; i++) { porTipo[i].limpiar(); porGenero[i].limpiar(); }
+        for (int i = 0; i < 2; i++) porEstado[i].limpiar();
+    }
+
+    // Mapa de un valor de atributo escrito como en las tablas (Agua, Mujer, Vivo, ...); NULL si no existe
+    const MapaBits* valor(const char* texto, size_t largo) const {
+        int v;
+        if ((v = tipoDesdeTexto(texto, largo)) >= 0) return &porTipo[v];
+        if ((v = generoDesdeTexto(texto, largo)) >= 0) return &porGenero[v];
+        if ((v = estadoDesdeTexto(texto, largo)) >= 0) return &porEstado[v];
+        return NULL;
+    }
+
+    // Analizador descendente recursivo de las consultas
+    struct Pieza {
+        const char* texto;
+        size_t largo;
+        Pieza(const char* t = NULL, size_t l = 0) : texto(t), largo(l) {}
+        bool es(const char* p) const { return largo == strlen(p) && memcmp(texto, p, largo) == 0; }
+        string str() const { return string(texto, largo); }
+    };
+
+    struct ConsultaAtributos {
+        const IndiceAtributos& indice;
+        const char* c;   // Posición de lectura
+        const char* fin;
+
+        ConsultaAtributos(const IndiceAtributos& i, const char* desde, const char* hasta) : indice(i), c(desde), fin(hasta) {}
+
+        // Próxima pieza sin consumirla: '(' , ')' o una palabra (vacía al final)
+        Pieza siguiente() {
+            while (c < fin && (*c == ' ' || *c == '\t' || *c == '\r')) c++;
+            if (c == fin) return Pieza();
+            if (*c == '(' || *c == ')') return Pieza(c, 1);
+            const char* p = c;
+            while (p < fin && *p != ' ' && *p != '\t' && *p != '\r' && *p != '(' && *p != ')') p++;
+            return Pieza(c, p - c);
+        }
+        void consumir() { Pieza p = siguiente(); c += p.largo; }
+
+        // Resultado parcial: un mapa propio o uno del índice (sin copiarlo), quizás negado
+        struct Valor {
+            MapaBits propio;
+            const MapaBits* referencia; // NULL: el valor está en 'propio'
+            bool negado;                // true: el valor es "todos AND NOT mapa()"
+            Valor() : referencia(NULL), negado(false) {}
+            const MapaBits& mapa() const { return referencia ? *referencia : propio; }
+        };
+
+        // Calcula la negación pendiente (solo hace falta para OR y al final)
+        void resolver(Valor& v) {
+            if (!v.negado) return;
+            v.propio = MapaBits::diferencia(indice.todos, v.mapa());
+            v.referencia = NULL;
+            v.negado = false;
+        }
+
+        static bool porCantidad(const MapaBits* a, const MapaBits* b) { return a->cantidad() < b->cantidad(); }
+
+        bool o(Valor& r, string& error) {
+            if (!y(r, error)) return false;
+            while (siguiente().es("OR")) {
+                consumir();
+                Valor otro;
+                if (!y(otro, error)) return false;
+                resolver(r);
+                resolver(otro);
+                r.propio = MapaBits::union_(r.mapa(), otro.mapa());
+                r.referencia = NULL;
+            }
+            return true;
+        }
+
+        // Junta los factores de un AND: cruza los positivos del más chico al más grande y después
+        // resta los negados, así "NOT x" nunca se arma contra todos los ids
+        bool y(Valor& r, string& error) {
+            vector<Valor> factores(1);
+            if (!no(factores[0], error)) return false;
+            for (;;) {
+                Pieza p = siguiente();
+                if (p.largo == 0 || p.es(")") || p.es("OR")) break;
+                if (p.es("AND")) consumir();
+                factores.push_back(Valor());
+                if (!no(factores.back(), error)) return false;
+            }
+            if (factores.size() == 1) { r = move(factores[0]); return true; }
+            vector<const MapaBits*> positivos, negados;
+            for (size_t i = 0; i < factores.size(); i++) (factores[i].negado ? negados : positivos).push_back(&factores[i].mapa());
+            sort(positivos.begin(), positivos.end(), porCantidad);
+            MapaBits acumulado;
+            size_t n = 0;
+            if (positivos.empty()) acumulado = MapaBits::diferencia(indice.todos, *negados[n++]);
+            else if (positivos.size() == 1) acumulado = *positivos[0];
+            else acumulado = MapaBits::interseccion(*positivos[0], *positivos[1]);
+            for (size_t i = 2; i < positivos.size(); i++) acumulado = MapaBits::interseccion(acumulado, *positivos[i]);
+            for (; n < negados.size(); n++) acumulado = MapaBits::diferencia(acumulado, *negados[n]);
+            r.propio = move(acumulado);
+            r.referencia = NULL;
+            r.negado = false;
+            return true;
+        }
+
+        bool no(Valor& r, string& error) {
+            Pieza p = siguiente();
+            if (p.largo == 0) { error = "Consulta incompleta."; return false; }
+            consumir();
+            if (p.es("NOT")) {
+                if (!no(r, error)) return false;
+                r.negado = !r.negado;
+                return true;
+            }
+            if (p.es("(")) {
+                if (!o(r, error)) return false;
+                if (!siguiente().es(")")) { error = "Falta ')' en la consulta."; return false; }
+                consumir();
+                return true;
+            }
+            r.referencia = indice.valor(p.texto, p.largo);
+            if (!r.referencia) { error = "Valor desconocido en la consulta: " + p.str() + "."; return false; }
+            return true;
+        }
+    };
+
+    // Evalúa una consulta como "Agua AND Mujer AND NOT Muerto" o "(Agua OR Roca) Vivo".
+    // Gramática: o := y (OR y)* ; y := no ([AND] no)* ; no := NOT no | ( o ) | valor.
+    // Dos términos seguidos sin operador se toman como AND. Devuelve false con el motivo en 'error'.
+    bool consultar(const char* texto, size_t largo, MapaBits& resultado, string& error) const {
+        ConsultaAtributos c(*this, texto, texto + largo);
+        ConsultaAtributos::Valor v;
+        if (!c.o(v, error)) return false;
+        if (c.siguiente().largo != 0) { error = "Consulta invalida cerca de '" + c.siguiente().str() + "'."; return false; }
+        c.resolver(v);
+        if (v.referencia) resultado = *v.referencia;
+        else resultado = move(v.propio);
+        return true;
+    }
+};
+
+// --------------------------------------
+// ARCHIVO MAPEADO EN MEMORIA (solo lectura)
+// --------------------------------------
+// Deja el contenido de un archivo accesible como un arreglo de bytes. En POSIX usa mmap, así que
+// no se copia nada: el sistema trae las páginas a memoria a medida que se leen.
+struct ArchivoMapeado {
+    const char* datos; // Primer byte del archivo (NULL si no hay nada abierto)
+    size_t tam;        // Tamaño del archivo en bytes
+#ifdef _WIN32
+    vector<char> copia; // En Windows se lee el archivo completo a memoria
+#endif
+
+    ArchivoMapeado() {
+        datos = NULL;
+        tam = 0;
+    }
+
+    ~ArchivoMapeado() {
+        cerrar();
+    }
+
+    ArchivoMapeado(const ArchivoMapeado&) = delete;
+    ArchivoMapeado& operator=(const ArchivoMapeado&) = delete;
+
+    // Mapea el archivo; devuelve false si no se pudo abrir
+    bool abrir(const char* ruta) {
+        cerrar();
+#ifdef _WIN32
+        FILE* f = fopen(ruta, "rb");
+        if (!f) return false;
+        fseek(f, 0, SEEK_END);
+        long largo = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        copia.resize(largo > 0 ? (size_t)largo : 1);
+        tam = fread(&copia[0], 1, (size_t)(largo > 0 ? largo : 0), f);
+        fclose(f);
+        datos = &copia[0];
+        return true;
+#else
+        int fd = open(ruta, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0) { close(fd); return false; }
+        tam = (size_t)info.st_size;
+        if (tam == 0) { close(fd); datos = ""; return true; } // mmap no acepta archivos vacíos
+        void* m = mmap(NULL, tam, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd); // El mapeo sigue siendo válido después de cerrar el descriptor
+        if (m == MAP_FAILED) { tam = 0; return false; }
+        madvise(m, tam, MADV_WILLNEED); // Pide al sistema que empiece a traer las páginas
+        datos = (const char*)m;
+        return true;
+#endif
+    }
+
+    // Se queda con el mapeo de 'otro' (que queda cerrado)
+    void adoptar(ArchivoMapeado& otro) {
+        cerrar();
+        datos = otro.datos;
+        tam = otro.tam;
+#ifdef _WIN32
+        copia.swap(otro.copia);
+#endif
+        otro.datos = NULL;
+        otro.tam = 0;
+    }
+
+    // Libera el mapeo (los punteros a 'datos' dejan de ser válidos)
+    void cerrar() {
+#ifdef _WIN32
+        copia.clear();
+#else
+        if (datos && tam > 0) munmap((void*)datos, tam);
+#endif
+        datos = NULL;
+        tam = 0;
+    }
+};
+
+// --------------------------------------
+// FORMATO BINARIO DE LAS INSTANTÁNEAS
+// --------------------------------------
+// Archivo = CabeceraInstantanea + RegistroNodo[cantidad] + nombres (cada uno terminado en '\0').
+// Los nodos van en orden BFS y se enlazan por su posición en la tabla. Los enteros se guardan
+// en el orden de bytes de la máquina. La versión 1 no tiene el campo 'guardado' (su cabecera
+// termina en largoNombres) y sus nacimientos se toman relativos a start_time, como antes.
+const char MAGIA_INSTANTANEA[8] = { 'A', 'R', 'B', 'O', 'L', 'G', 'E', 'N' };
+const uint32_t VERSION_INSTANTANEA = 2;
+const size_t LARGO_CABECERA_V1 = 24;
+const uint32_t SIN_NODO = 0xFFFFFFFFu; // Posición que indica "no hay nodo" (sin padre o sin hijo)
+
+struct CabeceraInstantanea {
+    char magia[8];         // "ARBOLGEN"
+    uint32_t version;      // VERSION_INSTANTANEA
+    uint32_t cantidad;     // Cantidad de nodos de la tabla
+    uint64_t largoNombres; // Bytes de la zona de nombres
+    int64_t guardado;      // Hora del sistema al guardar: las edades se cuentan hasta ese momento
+
+    // Lee la cabecera de 'datos' (de cualquier versión; los campos que no tiene quedan en 0)
+    void leer(const char* datos, size_t tam) {
+        memset(this, 0, sizeof(*this));
+        memcpy(this, datos, min(tam, sizeof(*this)));
+    }
+    size_t largo() const { return version == 1 ? LARGO_CABECERA_V1 : sizeof(*this); }
+};
+
+struct RegistroNodo {
+    uint32_t nombre;       // Desplazamiento del nombre dentro de la zona de nombres
+    uint32_t largo;        // Largo del nombre (sin el '\0')
+    uint32_t padre;        // Posición del padre (SIN_NODO en la raíz)
+    uint32_t izquierda;    // Posición del hijo izquierdo (o SIN_NODO)
+    uint32_t derecha;      // Posición del hijo derecho (o SIN_NODO)
+    uint8_t tipo;          // Tipo
+    uint8_t genero;        // Genero
+    uint8_t estado;        // Estado
+    uint8_t relleno;       // Sin uso (alinea el registro)
+    int64_t nacimiento;    // Momento de nacimiento en segundos desde 1/1/1970 (ver diferenciaReloj)
+};
+
+// --------------------------------------
+// IMPORTACIÓN DE CSV/TSV
+// --------------------------------------
+// Lee un archivo con una fila por personaje: nombre, tipo, genero, estado, padre y, opcional,
+// nacimiento (segundos desde 1/1/1970, como en las instantáneas). La raíz es la única fila con el
+// padre vacío. El separador es el tabulador si la primera línea tiene uno y la coma si no; una
+// primera línea que empieza con "nombre" se toma como encabezado. Las filas pueden venir en
+// cualquier orden: se arma una tabla en orden BFS igual a la de las instantáneas y el árbol se
+// construye con ella en una sola pasada.
+//
+// El archivo se mapea en memoria y cada paso pesado se reparte en trozos entre los núcleos:
+// separar las filas, cargar la tabla hash nombre -> fila (sin cerrojos), resolver los padres y
+// contar los hijos. Si algo falla (nombre repetido, padre inexistente, padre con más de 2 hijos,
+// filas que no cuelgan de la raíz) no se toca el árbol y se informan las primeras líneas con error.
+struct ImportacionCsv {
+    struct Fila {
+        const char* nombre;  // Apuntan dentro del archivo mapeado
+        const char* padre;
+        uint32_t largo;
+        uint32_t largoPadre;
+        int64_t nacimiento;
+        uint32_t linea;      // Línea del archivo (para los mensajes de error)
+        uint8_t tipo;
+        uint8_t genero;
+        uint8_t estado;
+    };
+    struct Falla {
+        uint32_t linea;
+        string motivo;
+        bool operator<(const Falla& o) const { return linea < o.linea; }
+    };
+
+    static const size_t MAX_FALLAS = 20; // Errores que se informan (los demás solo se cuentan)
+
+    ArchivoMapeado mapa;
+    vector<Fila> filas;
+    vector<uint32_t> padre;     // Fila del padre de cada fila (SIN_NODO en la raíz)
+    vector<uint32_t> hijos;     // Dos por fila, el de la línea más chica primero (SIN_NODO si falta)
+    vector<uint32_t> ordenBfs;  // Filas en el orden en que se crean los nodos
+    vector<RegistroNodo> tabla; // Misma forma que la tabla de una instantánea, en orden BFS
+    vector<Falla> fallas;
+    size_t totalFallas;
+    int hilos;
+    int64_t momento;            // Hora del sistema al leer: nacimiento de las filas que no lo traen
+
+    ImportacionCsv() : totalFallas(0), hilos(1), momento(0) {}
+
+    // Ejecuta trabajo(k) para k = 0..hilos-1, cada uno en su hilo
+    template <class Trabajo>
+    void enParalelo(Trabajo trabajo) {
+        vector<thread> grupo;
+        for (int k = 1; k < hilos; k++) grupo.push_back(thread(trabajo, k));
+        trabajo(0);
+        for (size_t k = 0; k < grupo.size(); k++) grupo[k].join();
+    }
+
+    // Rango [desde, hasta) de 'total' elementos que le toca al hilo k
+    void trozo(size_t total, int k, size_t& desde, size_t& hasta) const {
+        desde = total * k / hilos;
+        hasta = total * (k + 1) / hilos;
+    }
+
+    void juntarFallas(vector<Falla>& locales) { // Pasa los errores de un hilo a 'fallas' y deja 'locales' vacío
+        totalFallas += locales.size();
+        fallas.insert(fallas.end(), locales.begin(), locales.end());
+        locales.clear();
+    }
+
+    // Saca los espacios de los costados y las comillas que rodean al campo
+    static void limpiarCampo(const char*& p, const char*& fin) {
+        while (p < fin && (*p == ' ' || *p == '\r')) p++;
+        while (fin > p && (fin[-1] == ' ' || fin[-1] == '\r')) fin--;
+        if (fin - p >= 2 && *p == '"' && fin[-1] == '"') { p++; fin--; }
+    }
+
+    // Separa y valida las filas de [p, fin), que empieza en la línea 'linea' del archivo
+    static void leerTrozo(const char* p, const char* fin, char separador, uint32_t linea, int64_t ahora,
+                          vector<Fila>& salida, vector<Falla>& malas) {
+        for (; p < fin; linea++) {
+            const char* salto = (const char*)memchr(p, '\n', fin - p);
+            const char* finLinea = salto ? salto : fin;
+            const char* campo[6];
+            const char* finCampo[6];
+            int cantidad = 0;
+            const char* c = p;
+            while (true) { // Campos separados por 'separador'
+                const char* sep = (const char*)memchr(c, separador, finLinea - c);
+                const char* finC = sep ? sep : finLinea;
+                if (cantidad < 6) { campo[cantidad] = c; finCampo[cantidad] = finC; limpiarCampo(campo[cantidad], finCampo[cantidad]); }
+                cantidad++;
+                if (!sep) break;
+                c = sep + 1;
+            }
+            p = finLinea + 1;
+            if (cantidad == 1 && campo[0] == finCampo[0]) continue; // Línea vacía
+            Falla falla = { linea, "" };
+            if (cantidad != 5 && cantidad != 6) { falla.motivo = "se esperaban 5 o 6 columnas (nombre, tipo, genero, estado, padre[, nacimiento])"; malas.push_back(falla); continue; }
+            Fila f;
+            f.nombre = campo[0]; f.largo = (uint32_t)(finCampo[0] - campo[0]);
+            f.padre = campo[4];  f.largoPadre = (uint32_t)(finCampo[4] - campo[4]);
+            int tipo = tipoDesdeTexto(campo[1], finCampo[1] - campo[1]);
+            int genero = generoDesdeTexto(campo[2], finCampo[2] - campo[2]);
+            int estado = estadoDesdeTexto(campo[3], finCampo[3] - campo[3]);
+            f.nacimiento = ahora;
+            if (cantidad == 6 && finCampo[5] > campo[5]) {
+                string texto(campo[5], finCampo[5]);
+                char* resto;
+                f.nacimiento = strtoll(texto.c_str(), &resto, 10);
+                if (*resto) { falla.motivo = "nacimiento invalido: " + texto; malas.push_back(falla); continue; }
+            }
+            if (f.largo == 0) falla.motivo = "falta el nombre";
+            else if (tipo < 0) falla.motivo = "tipo invalido: " + string(campo[1], finCampo[1]);
+            else if (genero < 0) falla.motivo = "genero invalido: " + string(campo[2], finCampo[2]);
+            else if (estado < 0) falla.motivo = "estado invalido: " + string(campo[3], finCampo[3]);
+            if (!falla.motivo.empty()) { malas.push_back(falla); continue; }
+            f.tipo = (uint8_t)tipo; f.genero = (uint8_t)genero; f.estado = (uint8_t)estado;
+            f.linea = linea;
+            salida.push_back(f);
+        }
+    }
+
+    // Paso 1: separa el archivo en filas. Cada hilo toma un trozo que empieza después de un salto de línea.
+    void separarFilas() {
+        const char* inicio = mapa.datos;
+        const char* fin = mapa.datos + mapa.tam;
+        const char* salto = (const char*)memchr(inicio, '\n', fin - inicio);
+        const char* primera = salto ? salto : fin;
+        char separador = memchr(inicio, '\t', primera - inicio) ? '\t' : ',';
+        uint32_t lineaInicial = 1;
+        if (primera - inicio >= 6 && (inicio[0] == 'n' || inicio[0] == 'N') && memcmp(inicio + 1, "ombre", 5) == 0) { // Encabezado
+            inicio = salto ? salto + 1 : fin;
+            lineaInicial = 2;
+        }
+        hilos = (int)min<size_t>(max(1, (int)thread::hardware_concurrency()), (size_t)(fin - inicio) / (1 << 20) + 1);
+        vector<const char*> cortes(hilos + 1);
+        cortes[0] = inicio;
+        cortes[hilos] = fin;
+        for (int k = 1; k < hilos; k++) { // Cada corte se corre hasta el principio de una línea
+            const char* c = max(cortes[k - 1], inicio + (size_t)(fin - inicio) * k / hilos);
+            if (c > inicio && c < fin && c[-1] != '\n') {
+                const char* s = (const char*)memchr(c, '\n', fin - c);
+                c = s ? s + 1 : fin;
+            }
+            cortes[k] = c;
+        }
+        // Líneas de cada trozo, para que cada hilo sepa en qué línea empieza el suyo
+        vector<uint32_t> lineas(hilos + 1, 0);
+        enParalelo([&](int k) { lineas[k + 1] = (uint32_t)count(cortes[k], cortes[k + 1], '\n'); });
+        lineas[0] = lineaInicial;
+        for (int k = 1; k <= hilos; k++) lineas[k] += lineas[k - 1];
+
+        momento = (int64_t)time(NULL);
+        vector<vector<Fila> > partes(hilos);
+        vector<vector<Falla> > malas(hilos);
+        enParalelo([&](int k) { leerTrozo(cortes[k], cortes[k + 1], separador, lineas[k], momento, partes[k], malas[k]); });
+        size_t total = 0;
+        for (int k = 0; k < hilos; k++) { total += partes[k].size(); juntarFallas(malas[k]); }
+        filas.reserve(total);
+        for (int k = 0; k < hilos; k++) {
+            filas.insert(filas.end(), partes[k].begin(), partes[k].end());
+            vector<Fila>().swap(partes[k]); // Devuelve la memoria del trozo enseguida
+        }
+    }
+
+    // Pasos 2 y 3: tabla hash nombre -> fila y padre de cada fila
+    void resolverPadres() {
+        size_t n = filas.size();
+        size_t capacidad = 16;
+        while (capacidad < 2 * n) capacidad *= 2; // Carga de 50% como máximo
+        size_t mascara = capacidad - 1;
+        // Cada casilla guarda [hash de 32 bits][fila + 1] (0: vacía): el hash descarta casi todos
+        // los nombres distintos sin ir a mirar la fila ni el archivo
+        vector<atomic<uint64_t> > casillas(capacidad);
+
+        // Sondeo lineal sin cerrojos. Si un nombre se repite queda en la tabla la primera fila
+        // (la de línea más chica) y cada una de las demás se informa una sola vez.
+        vector<vector<Falla> > malas(hilos);
+        enParalelo([&](int k) {
+            size_t desde, hasta;
+            trozo(n, k, desde, hasta);
+            for (size_t i = desde; i < hasta; i++) {
+                const Fila& f = filas[i];
+                uint64_t hash = hashNombre(f.nombre, f.largo);
+                uint64_t propia = hash << 32 | (i + 1);
+                for (size_t c = hash & mascara; ; ) {
+                    uint64_t valor = casillas[c].load(memory_order_acquire);
+                    if (valor == 0) {
+                        if (casillas[c].compare_exchange_weak(valor, propia, memory_order_acq_rel)) break;
+                        continue; // Otro hilo ganó la casilla: se vuelve a mirar
+                    }
+                    const Fila& otra = filas[(uint32_t)valor - 1];
+                    if ((valor >> 32) == hash && otra.largo == f.largo && memcmp(otra.nombre, f.nombre, f.largo) == 0) {
+                        uint32_t repetida = (uint32_t)i;
+                        if (propia < valor) { // Esta fila va antes (mismo hash: decide la fila) y se queda con la casilla
+                            if (!casillas[c].compare_exchange_weak(valor, propia, memory_order_acq_rel)) continue;
+                            repetida = (uint32_t)valor - 1;
+                        }
+                        Falla falla = { filas[repetida].linea, "nombre repetido: " + string(f.nombre, f.largo) };
+                        malas[k].push_back(falla);
+                        break;
+                    }
+                    c = (c + 1) & mascara;
+                }
+            }
+        });
+        for (int k = 0; k < hilos; k++) juntarFallas(malas[k]);
+
+        padre.assign(n, SIN_NODO);
+        vector<vector<uint32_t> > raices(hilos);
+        enParalelo([&](int k) {
+            size_t desde, hasta;
+            trozo(n, k, desde, hasta);
+            for (size_t i = desde; i < hasta; i++) {
+                const Fila& f = filas[i];
+                if (f.largoPadre == 0) { raices[k].push_back((uint32_t)i); continue; }
+                uint64_t hash = hashNombre(f.padre, f.largoPadre);
+                for (size_t c = hash & mascara; ; c = (c + 1) & mascara) {
+                    uint64_t valor = casillas[c].load(memory_order_relaxed);
+                    if (valor == 0) {
+                        Falla falla = { f.linea, "no existe el padre " + string(f.padre, f.largoPadre) };
+                        malas[k].push_back(falla);
+                        break;
+                    }
+                    if ((valor >> 32) != hash) continue;
+                    const Fila& otra = filas[(uint32_t)valor - 1];
+                    if (otra.largo == f.largoPadre && memcmp(otra.nombre, f.padre, f.largoPadre) == 0) { padre[i] = (uint32_t)valor - 1; break; }
+                }
+            }
+        });
+        vector<uint32_t> todasRaices;
+        for (int k = 0; k < hilos; k++) {
+            juntarFallas(malas[k]);
+            todasRaices.insert(todasRaices.end(), raices[k].begin(), raices[k].end());
+        }
+        if (n == 0) { Falla falla = { 1, "el archivo no tiene personajes" }; fallas.push_back(falla); totalFallas++; }
+        else if (todasRaices.empty()) { Falla falla = { 1, "ninguna fila tiene el padre vacio (falta la raiz)" }; fallas.push_back(falla); totalFallas++; }
+        for (size_t i = 1; i < todasRaices.size(); i++) {
+            Falla falla = { filas[todasRaices[i]].linea, "hay mas de una raiz (la primera esta en la linea " + to_string(filas[todasRaices[0]].linea) + ")" };
+            fallas.push_back(falla);
+            totalFallas++;
+        }
+    }
+
+    // Paso 4: hijos de cada fila (a lo sumo 2; el de la línea más chica es el izquierdo)
+    void enlazarHijos() {
+        size_t n = filas.size();
+        hijos.assign(2 * n, SIN_NODO);
+        vector<atomic<uint32_t> > cantidad(n); // Hijos que declara cada fila (empiezan en 0)
+        enParalelo([&](int k) {
+            size_t desde, hasta;
+            trozo(n, k, desde, hasta);
+            for (size_t i = desde; i < hasta; i++) {
+                if (padre[i] == SIN_NODO) continue;
+                uint32_t lugar = cantidad[padre[i]].fetch_add(1, memory_order_relaxed);
+                if (lugar < 2) hijos[2 * padre[i] + lugar] = (uint32_t)i;
+            }
+        });
+        // Los hijos de un padre lleno se vuelven a juntar en orden de línea: sobran todos menos los dos primeros
+        vector<vector<pair<uint32_t, uint32_t> > > sobrantes(hilos); // (padre, fila)
+        enParalelo([&](int k) {
+            size_t desde, hasta;
+            trozo(n, k, desde, hasta);
+            for (size_t i = desde; i < hasta; i++) {
+                uint32_t* h = &hijos[2 * i];
+                if (h[1] != SIN_NODO && h[1] < h[0]) swap(h[0], h[1]);
+                if (padre[i] != SIN_NODO && cantidad[padre[i]].load(memory_order_relaxed) > 2)
+                    sobrantes[k].push_back(make_pair(padre[i], (uint32_t)i));
+            }
+        });
+        vector<pair<uint32_t, uint32_t> > llenos;
+        for (int k = 0; k < hilos; k++) llenos.insert(llenos.end(), sobrantes[k].begin(), sobrantes[k].end());
+        sort(llenos.begin(), llenos.end());
+        size_t lugar = 0;
+        for (size_t i = 0; i < llenos.size(); i++) {
+            uint32_t p = llenos[i].first;
+            lugar = (i > 0 && llenos[i - 1].first == p) ? lugar + 1 : 0;
+            if (lugar < 2) { hijos[2 * p + lugar] = llenos[i].second; continue; }
+            Falla falla = { filas[llenos[i].second].linea, "el padre " + string(filas[p].nombre, filas[p].largo) + " ya tiene 2 hijos" };
+            fallas.push_back(falla);
+            totalFallas++;
+        }
+    }
+
+    // Paso 5: orden BFS desde la raíz y tabla de nodos. Las filas que no se alcanzan forman un ciclo.
+    void ordenarBfs() {
+        size_t n = filas.size();
+        uint32_t raiz = SIN_NODO;
+        for (size_t i = 0; i < n && raiz == SIN_NODO; i++) if (padre[i] == SIN_NODO) raiz = (uint32_t)i;
+        ordenBfs.reserve(n);
+        vector<uint32_t> posicion(n, SIN_NODO);
+        if (raiz != SIN_NODO) { ordenBfs.push_back(raiz); posicion[raiz] = 0; }
+        tabla.reserve(n);
+        for (size_t k = 0; k < ordenBfs.size(); k++) {
+            uint32_t i = ordenBfs[k];
+            const Fila& f = filas[i];
+            RegistroNodo r;
+            memset(&r, 0, sizeof(r));
+            r.largo = f.largo;
+            r.padre = padre[i] == SIN_NODO ? SIN_NODO : posicion[padre[i]];
+            r.izquierda = r.derecha = SIN_NODO;
+            for (int h = 0; h < 2; h++) {
+                uint32_t hijo = hijos[2 * i + h];
+                if (hijo == SIN_NODO) continue;
+                posicion[hijo] = (uint32_t)ordenBfs.size();
+                (h == 0 ? r.izquierda : r.derecha) = posicion[hijo];
+                ordenBfs.push_back(hijo);
+            }
+            r.tipo = f.tipo; r.genero = f.genero; r.estado = f.estado;
+            r.nacimiento = f.nacimiento;
+            tabla.push_back(r);
+        }
+        if (ordenBfs.size() < n && fallas.empty()) { // Con otros errores, el ciclo puede ser solo una consecuencia
+            for (size_t i = 0; i < n; i++)
+                if (posicion[i] == SIN_NODO) {
+                    Falla falla = { filas[i].linea, string(filas[i].nombre, filas[i].largo) + " no desciende de la raiz (hay un ciclo)" };
+                    fallas.push_back(falla);
+                    totalFallas++;
+                    break;
+                }
+        }
+    }
+
+    // Lee y valida el archivo; si devuelve true, 'tabla' y 'ordenBfs' describen el árbol completo
+    bool leer(const char* ruta, string& error) {
+        if (!mapa.abrir(ruta)) { error = string("No se pudo abrir ") + ruta; return false; }
+        separarFilas();
+        if (filas.size() >= SIN_NODO) { error = "Demasiadas filas."; return false; }
+        resolverPadres();
+        if (fallas.empty()) enlazarHijos();  // Con nombres repetidos o padres que faltan no se puede seguir
+        if (fallas.empty()) ordenarBfs();
+        if (fallas.empty()) return true;
+        sort(fallas.begin(), fallas.end());
+        error.clear();
+        for (size_t i = 0; i < fallas.size() && i < MAX_FALLAS; i++)
+            error += (i ? "\n" : "") + string("linea ") + to_string(fallas[i].linea) + ": " + fallas[i].motivo;
+        if (totalFallas > MAX_FALLAS) error += "\n(y " + to_string(totalFallas - MAX_FALLAS) + " errores mas)";
+        return false;
+    }
+};
+
+// --------------------------------------
+// BITÁCORA DE OPERACIONES (write-ahead log)
+// --------------------------------------
+// Archivo de solo agregado con un registro por cada inserción, eliminación o cambio de estado hecho después de la
+// última instantánea. Cada registro es [largo u32][suma u32][contenido] y la suma (FNV-1a) permite
+// descartar un registro cortado por una caída. Los registros se juntan en memoria y se escriben
+// con un solo fsync por grupo ("group commit"): cuando hay 'maxOperaciones' pendientes o pasaron
+// 'maxMilisegundos' desde la última confirmación.
+const uint8_t BITACORA_INSERTAR = 1;
+const uint8_t BITACORA_ELIMINAR = 2;
+const uint8_t BITACORA_ESTADO = 3;
+
+struct Bitacora {
+    FILE* archivo;            // Archivo abierto para agregar
+    string ruta;              // Ruta del archivo
+    string pendiente;         // Registros todavía no escritos al disco
+    unsigned int operacionesPendientes; // Cantidad de registros en 'pendiente'
+    unsigned int maxOperaciones;        // Confirma al juntar esta cantidad de registros
+    unsigned int maxMilisegundos;       // Confirma si pasó este tiempo desde la última confirmación
+    chrono::steady_clock::time_point ultimaConfirmacion;
+    bool fallo;               // Hubo un error de escritura (ya se avisó por stderr)
+
+    Bitacora() {
+        archivo = NULL;
+        operacionesPendientes = 0;
+        maxOperaciones = 64;
+        maxMilisegundos = 50;
+        fallo = false;
+    }
+
+    ~Bitacora() {
+        cerrar();
+    }
+
+    Bitacora(const Bitacora&) = delete;
+    Bitacora& operator=(const Bitacora&) = delete;
+
+    // Abre el archivo para agregar registros; con 'vaciar' empieza uno nuevo (después de una instantánea)
+    bool abrir(const string& r, bool vaciar) {
+        cerrar();
+        ruta = r;
+        archivo = fopen(ruta.c_str(), vaciar ? "wb" : "ab");
+        ultimaConfirmacion = chrono::steady_clock::now();
+        return archivo != NULL;
+    }
+
+    void cerrar() {
+        if (!archivo) return;
+        confirmar();
+        fclose(archivo);
+        archivo = NULL;
+    }
+
+    // Agrega valores de tamaño fijo o texto al registro que se está armando
+    template <class T> static void agregar(string& destino, T valor) {
+        destino.append((const char*)&valor, sizeof(valor));
+    }
+    static void agregarTexto(string& destino, const char* texto, uint32_t largo) {
+        agregar(destino, largo);
+        destino.append(texto, largo);
+    }
+
+    // Lee un texto [largo u32][bytes] que empieza en 'c'; devuelve false si se pasa de 'limite'
+    static bool leerTexto(const char*& c, const char* limite, const char*& texto, uint32_t& largo) {
+        if (limite - c < 4) return false;
+        memcpy(&largo, c, 4);
+        c += 4;
+        if ((size_t)(limite - c) < largo) return false;
+        texto = c;
+        c += largo;
+        return true;
+    }
+
+    void registrarInsercion(Nodo* n) {
+        string contenido;
+        agregar(contenido, BITACORA_INSERTAR);
+        agregar(contenido, (uint8_t)n->tipo);
+        agregar(contenido, (uint8_t)n->genero);
+        agregar(contenido, (uint8_t)n->estado);
+        int64_t guardado = (int64_t)time(NULL);
+        agregar(contenido, n->nacimiento + diferenciaReloj(guardado)); // Momento absoluto, como en las instantáneas
+        agregarTexto(contenido, n->nombre, n->largo);
+        agregarTexto(contenido, n->padre->nombre, n->padre->largo);
+        agregar(contenido, (uint8_t)(n->padre->derecha == n)); // Lado del hijo (0 izquierdo, 1 derecho)
+        agregar(contenido, guardado); // Hora del registro: al reproducirlo la edad queda como era entonces
+        agregarRegistro(contenido);
+    }
+
+    void registrarEliminacion(Nodo* n) {
+        string contenido;
+        agregar(contenido, BITACORA_ELIMINAR);
+        agregarTexto(contenido, n->nombre, n->largo);
+        agregarRegistro(contenido);
+    }
+
+    void registrarEstado(Nodo* n, Estado nuevo) {
+        string contenido;
+        agregar(contenido, BITACORA_ESTADO);
+        agregar(contenido, (uint8_t)nuevo);
+        agregarTexto(contenido, n->nombre, n->largo);
+        agregarRegistro(contenido);
+    }
+
+    // Encola un registro y confirma el grupo si ya se juntaron suficientes o pasó el tiempo límite
+    void agregarRegistro(const string& contenido) {
+        agregar(pendiente, (uint32_t)contenido.size());
+        agregar(pendiente, hashNombre(contenido.data(), contenido.size()));
+        pendiente += contenido;
+        operacionesPendientes++;
+        if (operacionesPendientes >= maxOperaciones ||
+            chrono::steady_clock::now() - ultimaConfirmacion >= chrono::milliseconds(maxMilisegundos))
+            confirmar();
+    }
+
+    // Escribe los registros pendientes y los fuerza al disco con un solo fsync
+    bool confirmar() {
+        ultimaConfirmacion = chrono::steady_clock::now();
+        if (!archivo || pendiente.empty()) return !fallo;
+        bool ok = fwrite(pendiente.data(), 1, pendiente.size(), archivo) == pendiente.size()
+               && fflush(archivo) == 0;
+#ifdef _WIN32
+        ok = ok && _commit(_fileno(archivo)) == 0;
+#else
+        ok = ok && fsync(fileno(archivo)) == 0;
+#endif
+        if (!ok && !fallo) fprintf(stderr, "ERROR: no se pudo escribir la bitacora %s\n", ruta.c_str());
+        fallo = fallo || !ok;
+        pendiente.clear();
+        operacionesPendientes = 0;
+        return ok;
+    }
+};
+
+// --------------------------------------
+// VERSIONES PERSISTENTES (deshacer, rehacer y consultas al pasado)
+// --------------------------------------
+// Cada cambio (insertar, eliminar, cambiar estado) crea una versión nueva con su número. La versión
+// nueva comparte todos sus nodos con la anterior salvo el camino desde la raíz hasta el nodo que
+// cambió, que se copia: O(profundidad) de tiempo y memoria por cambio, nunca O(n). Un nodo de
+// versión no se modifica después de creado, así que al comparar dos versiones se saltan enteros
+// los subárboles que comparten (mismo puntero).
+struct NodoVersion {
+    const char* nombre;       // Copia en la arena del historial (el nodo vivo puede liberarse antes)
+    unsigned int largo;
+    unsigned char tipo   : 2;
+    unsigned char genero : 2;
+    unsigned char estado : 1;
+    int nacimiento;
+    unsigned int uid;         // Identidad del personaje: las copias de un nodo conservan la del original
+    unsigned int referencias; // Punteros que llegan a este nodo (padres de cualquier versión y raíces)
+    NodoVersion* hijo[2];     // [0] izquierda, [1] derecha
+};
+
+struct HistorialVersiones {
+    struct Version {
+        unsigned long long numero; // Número de secuencia: crece siempre y no se reutiliza
+        NodoVersion* raiz;
+        string cambio;             // Descripción corta del cambio que la creó
+    };
+
+    // Una diferencia entre dos versiones
+    struct Cambio {
+        const NodoVersion* nodo;
+        const NodoVersion* padre; // En la versión donde existe el nodo (NULL si es la raíz)
+        int lado;                 // 0 izquierda, 1 derecha
+        int estadoAnterior;       // Solo en los cambios de estado
+    };
+    struct Diferencias {
+        vector<Cambio> quitados;  // Solo en la versión de origen (las hojas antes que sus padres)
+        vector<Cambio> agregados; // Solo en la de destino (los padres antes que sus hijos)
+        vector<Cambio> estados;   // El mismo personaje con otro estado
+    };
+
+    static const size_t NODOS_POR_BLOQUE = 4096;
+
+    deque<Version> versiones;   // De la más vieja a la más nueva
+    size_t actual;              // Posición de la versión que coincide con el árbol vivo
+    size_t maximo;              // Versiones que se conservan (las más viejas se descartan)
+    unsigned long long siguienteNumero;
+    unsigned int siguienteUid;
+    ArenaNombres nombres;       // Nombres de todos los nodos de versión
+    vector<NodoVersion*> bloques;
+    NodoVersion* libres;        // Nodos devueltos, enlazados por hijo[0]
+    size_t nodosVivos;          // Nodos de versión en uso
+    vector<unsigned char> camino; // Camino del último cambio (se reutiliza para no pedir memoria)
+
+    explicit HistorialVersiones(size_t maximoVersiones)
+        : actual(0), maximo(maximoVersiones < 1 ? 1 : maximoVersiones), siguienteNumero(0),
+          siguienteUid(0), libres(NULL), nodosVivos(0) {}
+    ~HistorialVersiones() { liberarTodo(); }
+    HistorialVersiones(const HistorialVersiones&) = delete;
+    HistorialVersiones& operator=(const HistorialVersiones&) = delete;
+
+    void liberarTodo() {
+        for (size_t i = 0; i < bloques.size(); i++) delete[] bloques[i];
+        bloques.clear();
+        nombres.reiniciar();
+        versiones.clear();
+        libres = NULL;
+        nodosVivos = 0;
+        actual = 0;
+    }
+
+    NodoVersion* nuevoNodo() {
+        if (!libres) {
+            NodoVersion* bloque = new NodoVersion[NODOS_POR_BLOQUE];
+            bloques.push_back(bloque);
+            for (size_t i = 0; i < NODOS_POR_BLOQUE; i++) { bloque[i].hijo[0] = libres; libres = &bloque[i]; }
+        }
+        NodoVersion* x = libres;
+        libres = x->hijo[0];
+        nodosVivos++;
+        return x;
+    }
+
+    // Nodo de versión con los datos actuales de un nodo vivo (un personaje nuevo: uid nuevo)
+    NodoVersion* desdeVivo(const Nodo* n) {
+        NodoVersion* x = nuevoNodo();
+        x->nombre = nombres.guardar(n->nombre, n->largo);
+        x->largo = n->largo;
+        x->tipo = n->tipo;
+        x->genero = n->genero;
+        x->estado = n->estado;
+        x->nacimiento = n->nacimiento;
+        x->uid = siguienteUid++;
+        x->referencias = 1;
+        x->hijo[0] = x->hijo[1] = NULL;
+        return x;
+    }
+
+    // Copia de un nodo de versión: comparte los hijos (que ganan una referencia)
+    NodoVersion* copiar(const NodoVersion* x) {
+        NodoVersion* y = nuevoNodo();
+        *y = *x;
+        y->referencias = 1;
+        for (int i = 0; i < 2; i++) if (y->hijo[i]) y->hijo[i]->referencias++;
+        return y;
+    }
+
+    // Quita una referencia; los nodos que quedan sin ninguna vuelven a la lista libre (sin recursión)
+    void soltar(NodoVersion* x) {
+        vector<NodoVersion*> pila;
+        if (x) pila.push_back(x);
+        while (!pila.empty()) {
+            NodoVersion* y = pila.back();
+            pila.pop_back();
+            if (--y->referencias > 0) continue;
+            for (int i = 0; i < 2; i++) if (y->hijo[i]) pila.push_back(y->hijo[i]);
+            y->hijo[0] = libres;
+            libres = y;
+            nodosVivos--;
+        }
+    }
+
+    // Descarta todo el historial y arma la versión 0 copiando el árbol vivo (O(n), una sola vez)
+    void comenzar(Nodo* raiz) {
+        liberarTodo();
+        NodoVersion* copia = NULL;
+        vector<pair<Nodo*, NodoVersion**> > pila; // (nodo vivo, dónde va su copia)
+        if (raiz) pila.push_back(make_pair(raiz, &copia));
+        while (!pila.empty()) {
+            Nodo* n = pila.back().first;
+            NodoVersion** destino = pila.back().second;
+            pila.pop_back();
+            NodoVersion* x = desdeVivo(n);
+            *destino = x;
+            if (n->izquierda) pila.push_back(make_pair((Nodo*)n->izquierda, &x->hijo[0]));
+            if (n->derecha)   pila.push_back(make_pair((Nodo*)n->derecha, &x->hijo[1]));
+        }
+        Version v = { siguienteNumero++, copia, "inicio" };
+        versiones.push_back(v);
+        actual = 0;
+    }
+
+    // Lados (0 izquierda, 1 derecha) del camino desde la raíz hasta 'n' en el árbol vivo
+    static void caminoDe(const Nodo* n, vector<unsigned char>& lados) {
+        lados.clear();
+        for (; n->padre; n = n->padre) lados.push_back(n->padre->derecha == n ? 1 : 0);
+        reverse(lados.begin(), lados.end());
+    }
+
+    // Copia la raíz de la versión actual y los 'pasos' primeros nodos del camino de 'lados';
+    // deja en 'ultimo' la copia más profunda y devuelve la raíz nueva
+    NodoVersion* copiarCamino(const vector<unsigned char>& lados, size_t pasos, NodoVersion*& ultimo) {
+        NodoVersion* raiz = copiar(versiones[actual].raiz);
+        ultimo = raiz;
+        for (size_t i = 0; i < pasos; i++) {
+            NodoVersion* original = ultimo->hijo[lados[i]];
+            NodoVersion* copia = copiar(original);
+            original->referencias--; // La copia del padre ahora apunta a la copia (la versión vieja lo sigue usando)
+            ultimo->hijo[lados[i]] = copia;
+            ultimo = copia;
+        }
+        return raiz;
+    }
+
+    // Agrega la versión nueva. Si se había deshecho algo, lo que se podía rehacer se pierde.
+    void agregarVersion(NodoVersion* raiz, const string& cambio) {
+        while (versiones.size() > actual + 1) { soltar(versiones.back().raiz); versiones.pop_back(); }
+        Version v = { siguienteNumero++, raiz, cambio };
+        versiones.push_back(v);
+        while (versiones.size() > maximo) { soltar(versiones.front().raiz); versiones.pop_front(); }
+        actual = versiones.size() - 1;
+    }
+
+    // Se llama después de enlazar 'n' en el árbol vivo
+    void registrarInsercion(const Nodo* n) {
+        caminoDe(n, camino);
+        NodoVersion* padre;
+        NodoVersion* raiz = copiarCamino(camino, camino.size() - 1, padre);
+        padre->hijo[camino.back()] = desdeVivo(n);
+        agregarVersion(raiz, "INSERT " + string(n->nombre, n->largo));
+    }
+
+    // Se llama antes de quitar la hoja 'n' del árbol vivo
+    void registrarEliminacion(const Nodo* n) {
+        caminoDe(n, camino);
+        NodoVersion* padre;
+        NodoVersion* raiz = copiarCamino(camino, camino.size() - 1, padre);
+        padre->hijo[camino.back()]->referencias--; // Lo sigue usando la versión anterior
+        padre->hijo[camino.back()] = NULL;
+        agregarVersion(raiz, "DELETE " + string(n->nombre, n->largo));
+    }
+
+    void registrarEstado(const Nodo* n, Estado nuevo) {
+        caminoDe(n, camino);
+        NodoVersion* copia;
+        NodoVersion* raiz = copiarCamino(camino, camino.size(), copia);
+        copia->estado = nuevo;
+        agregarVersion(raiz, "SET " + string(n->nombre, n->largo) + " " + TEXTO_ESTADO[nuevo]);
+    }
+
+    // Posición de la versión 'numero' en 'versiones', o -1 si no existe (o ya se descartó)
+    // (los números crecen pero pueden tener huecos: las versiones que se podían rehacer y se descartaron)
+    long posicion(unsigned long long numero) const {
+        size_t desde = 0, hasta = versiones.size();
+        while (desde < hasta) { // Búsqueda binaria
+            size_t medio = (desde + hasta) / 2;
+            if (versiones[medio].numero < numero) desde = medio + 1;
+            else hasta = medio;
+        }
+        return desde < versiones.size() && versiones[desde].numero == numero ? (long)desde : -1;
+    }
+
+    const NodoVersion* raizDe(unsigned long long numero) const {
+        long i = posicion(numero);
+        return i < 0 ? NULL : versiones[i].raiz;
+    }
+
+    unsigned long long numeroActual() const { return versiones[actual].numero; }
+
+    // Agrega a 'salida' el subárbol de 'x' en preorden (padres primero) o en postorden (hojas primero)
+    static void subarbol(const NodoVersion* x, const NodoVersion* padre, int lado, bool hojasPrimero, vector<Cambio>& salida) {
+        size_t inicio = salida.size();
+        vector<Cambio> pila;
+        Cambio c = { x, padre, lado, 0 };
+        pila.push_back(c);
+        while (!pila.empty()) {
+            Cambio actual = pila.back();
+            pila.pop_back();
+            salida.push_back(actual);
+            for (int i = 1; i >= 0; i--) { // El izquierdo queda arriba de la pila: se visita primero
+                if (!actual.nodo->hijo[i]) continue;
+                Cambio h = { actual.nodo->hijo[i], actual.nodo, i, 0 };
+                pila.push_back(h);
+            }
+        }
+        if (hojasPrimero) reverse(salida.begin() + inicio, salida.end()); // Preorden al revés: cada nodo después de sus hijos
+    }
+
+    // Cambios que llevan de la versión con raíz 'a' a la versión con raíz 'b'. Se comparan posición por
+    // posición; los subárboles compartidos (mismo puntero) no se recorren.
+    static void diferencias(const NodoVersion* a, const NodoVersion* b, Diferencias& d) {
+        struct Par { const NodoVersion* a; const NodoVersion* b; const NodoVersion* padreA; const NodoVersion* padreB; int lado; };
+        vector<Par> pila;
+        Par inicio = { a, b, NULL, NULL, 0 };
+        pila.push_back(inicio);
+        while (!pila.empty()) {
+            Par p = pila.back();
+            pila.pop_back();
+            if (p.a == p.b) continue; // Subárbol compartido (o las dos posiciones vacías)
+            if (p.a && p.b && p.a->uid == p.b->uid) { // El mismo personaje: se compara su estado y se baja
+                if (p.a->estado != p.b->estado) {
+                    Cambio c = { p.b, p.padreB, p.lado, p.a->estado };
+                    d.estados.push_back(c);
+                }
+                for (int i = 1; i >= 0; i--) {
+                    Par h = { p.a->hijo[i], p.b->hijo[i], p.a, p.b, i };
+                    pila.push_back(h);
+                }
+                continue;
+            }
+            if (p.a) subarbol(p.a, p.padreA, p.lado, true, d.quitados);
+            if (p.b) subarbol(p.b, p.padreB, p.lado, false, d.agregados);
+        }
+    }
+
+    // Vista por generaciones de una versión (mismos formatos PLANO y TSV que la del árbol vivo)
+    static void escribirGeneraciones(Salida& s, const NodoVersion* raiz, FormatoSalida formato, int ahora) {
+        if (formato == FORMATO_TSV) s.texto("generacion\tnombre\ttipo\tgenero\testado\tpadre\thijos\tedad\n");
+        else s.texto("\n=== ARBOL POR GENERACIONES ===\n");
+        struct Fila { const NodoVersion* nodo; const NodoVersion* padre; int nivel; };
+        vector<Fila> q; // Cola BFS: los nodos de versión no guardan padre ni nivel, van en la fila
+        if (raiz) { Fila f = { raiz, NULL, 0 }; q.push_back(f); }
+        int nivelActual = -1;
+        for (size_t i = 0; i < q.size(); i++) {
+            Fila f = q[i];
+            const NodoVersion* x = f.nodo;
+            int hijos = (x->hijo[0] != NULL) + (x->hijo[1] != NULL);
+            if (formato == FORMATO_TSV) {
+                s.entero(f.nivel); s.caracter('\t');
+                s.texto(x->nombre, x->largo); s.caracter('\t');
+                s.texto(TEXTO_TIPO[x->tipo]); s.caracter('\t');
+                s.texto(TEXTO_GENERO[x->genero]); s.caracter('\t');
+                s.texto(TEXTO_ESTADO[x->estado]); s.caracter('\t');
+                if (f.padre) s.texto(f.padre->nombre, f.padre->largo);
+                s.caracter('\t');
+                s.entero(hijos); s.caracter('\t');
+                s.entero(ahora - x->nacimiento); s.caracter('\n');
+            } else {
+                if (f.nivel != nivelActual) {
+                    nivelActual = f.nivel;
+                    s.texto("\n--- GENERACION "); s.entero(f.nivel); s.texto(" ---\n");
+                }
+                s.texto("Nombre: "); s.texto(x->nombre, x->largo);
+                s.texto(" | Tipo: "); s.texto(TEXTO_TIPO[x->tipo]);
+                s.texto(" | Genero: "); s.texto(TEXTO_GENERO[x->genero]);
+                s.texto(" | Estado: "); s.texto(TEXTO_ESTADO[x->estado]);
+                s.texto(" | Padre: ");
+                if (f.padre) s.texto(f.padre->nombre, f.padre->largo); else s.texto("Ninguno");
+                s.texto(" | Hijos: "); s.entero(hijos);
+                s.texto(" | Edad: "); s.entero(ahora - x->nacimiento);
+                s.caracter('\n');
+            }
+            for (int h = 0; h < 2; h++)
+                if (x->hijo[h]) { Fila c = { x->hijo[h], x, f.nivel + 1 }; q.push_back(c); }
+        }
+    }
+
+    // Diferencias en texto: "+ nombre (padre)", "- nombre", "~ nombre Vivo -> Muerto"
+    static void escribirDiferencias(Salida& s, const Diferencias& d) {
+        for (size_t i = 0; i < d.quitados.size(); i++) {
+            s.texto("- "); s.texto(d.quitados[i].nodo->nombre, d.quitados[i].nodo->largo); s.caracter('\n');
+        }
+        for (size_t i = 0; i < d.agregados.size(); i++) {
+            const Cambio& c = d.agregados[i];
+            s.texto("+ "); s.texto(c.nodo->nombre, c.nodo->largo);
+            if (c.padre) { s.texto(" ("); s.texto(c.padre->nombre, c.padre->largo); s.caracter(')'); }
+            s.caracter('\n');
+        }
+        for (size_t i = 0; i < d.estados.size(); i++) {
+            const Cambio& c = d.estados[i];
+            s.texto("~ "); s.texto(c.nodo->nombre, c.nodo->largo);
+            s.caracter(' '); s.texto(TEXTO_ESTADO[c.estadoAnterior]);
+            s.texto(" -> "); s.texto(TEXTO_ESTADO[c.nodo->estado]); s.caracter('\n');
+        }
+    }
+};
+
+// --------------------------------------
+// ÁRBOL GENÉRICO (solo en la compilación para benchmarks)
+// --------------------------------------
+// Se compila solo con -DARBOL_GENERICO, que agrega sus filas al bench (generico2, generico4,
+// generico_hermanos). El programa no lo usa: el árbol genealógico sigue siendo Arbol.
+#ifdef ARBOL_GENERICO
+// ArbolGenerico<Carga, MaxHijos> guarda cualquier carga con hasta MaxHijos hijos por nodo:
+//   - MaxHijos > 0: los hijos van en un arreglo dentro del nodo (para familias chicas: 2, 3, 4...)
+//   - MaxHijos == 0: familias sin límite, con "primer hijo / siguiente hermano" (el nodo ocupa lo
+//     mismo tenga uno o mil hijos)
+// La forma de los enlaces se elige al compilar (especialización de EnlacesHijos): la versión con
+// arreglo no tiene listas de hermanos y la de hermanos no tiene arreglo ni conjunto de libres.
+// Lo usa un solo hilo.
+template <class NodoT, int N>
+struct EnlacesHijos { // Hasta N hijos en un arreglo, sin huecos y en orden de llegada
+    NodoT* hijo[N];
+    unsigned int cantidad;
+
+    EnlacesHijos() : cantidad(0) {}
+
+    static bool lleno(const NodoT* n) { return n->enlaces.cantidad == (unsigned int)N; }
+    static NodoT* primero(const NodoT* n) { return n->enlaces.cantidad ? n->enlaces.hijo[0] : NULL; }
+
+    static NodoT* siguienteHermano(const NodoT* n) { // Busca a 'n' en el arreglo del padre (N es chico)
+        const EnlacesHijos& e = n->padre->enlaces;
+        for (unsigned int i = 0; i + 1 < e.cantidad; i++)
+            if (e.hijo[i] == n) return e.hijo[i + 1];
+        return NULL;
+    }
+
+    static unsigned int lugar(const NodoT* n) { // Posición de 'n' entre sus hermanos
+        const EnlacesHijos& e = n->padre->enlaces;
+        unsigned int i = 0;
+        while (e.hijo[i] != n) i++;
+        return i;
+    }
+
+    static void agregar(NodoT* padre, NodoT* h) { padre->enlaces.hijo[padre->enlaces.cantidad++] = h; }
+
+    static void quitar(NodoT* padre, NodoT* h) { // Corre un lugar los hijos que venían después
+        EnlacesHijos& e = padre->enlaces;
+        unsigned int i = 0;
+        while (e.hijo[i] != h) i++;
+        for (; i + 1 < e.cantidad; i++) e.hijo[i] = e.hijo[i + 1];
+        e.cantidad--;
+    }
+};
+
+template <class NodoT>
+struct EnlacesHijos<NodoT, 0> { // Sin límite: primer y último hijo, y los hermanos enlazados en los dos sentidos
+    NodoT* primerHijo;
+    NodoT* ultimoHijo; // Para agregar al final sin recorrer la familia
+    NodoT* hermano;    // Siguiente hermano
+    NodoT* anterior;   // Hermano anterior (para quitar un hijo sin buscarlo)
+    unsigned int cantidad;
+
+    EnlacesHijos() : primerHijo(NULL), ultimoHijo(NULL), hermano(NULL), anterior(NULL), cantidad(0) {}
+
+    static bool lleno(const NodoT*) { return false; }
+    static NodoT* primero(const NodoT* n) { return n->enlaces.primerHijo; }
+    static NodoT* siguienteHermano(const NodoT* n) { return n->enlaces.hermano; }
+
+    static unsigned int lugar(const NodoT* n) { // Posición de 'n' entre sus hermanos
+        unsigned int i = 0;
+        for (const NodoT* h = n->enlaces.anterior; h; h = h->enlaces.anterior) i++;
+        return i;
+    }
+
+    static void agregar(NodoT* padre, NodoT* h) {
+        EnlacesHijos& e = padre->enlaces;
+        h->enlaces.anterior = e.ultimoHijo;
+        if (e.ultimoHijo) e.ultimoHijo->enlaces.hermano = h;
+        else e.primerHijo = h;
+        e.ultimoHijo = h;
+        e.cantidad++;
+    }
+
+    static void quitar(NodoT* padre, NodoT* h) {
+        EnlacesHijos& e = padre->enlaces;
+        NodoT* antes = h->enlaces.anterior;
+        NodoT* despues = h->enlaces.hermano;
+        if (antes) antes->enlaces.hermano = despues; else e.primerHijo = despues;
+        if (despues) despues->enlaces.anterior = antes; else e.ultimoHijo = antes;
+        h->enlaces.anterior = h->enlaces.hermano = NULL;
+        e.cantidad--;
+    }
+};
+
+template <class Carga, int MaxHijos>
+struct NodoGenerico {
+    typedef EnlacesHijos<NodoGenerico, MaxHijos> Enlaces;
+
+    Carga carga;           // Datos del nodo (los elige quien usa el árbol)
+    NodoGenerico* padre;   // NULL en la raíz
+    int profundidad;       // Generación (la raíz es la 0)
+    Enlaces enlaces;       // Hijos (arreglo o primer hijo/hermanos, según MaxHijos)
+
+    NodoGenerico(const Carga& c, NodoGenerico* p)
+        : carga(c), padre(p), profundidad(p ? p->profundidad + 1 : 0) {}
+
+    unsigned int hijos() const { return enlaces.cantidad; }
+    NodoGenerico* primerHijo() const { return Enlaces::primero(this); }
+    NodoGenerico* siguienteHermano() const { return padre ? Enlaces::siguienteHermano(this) : NULL; }
+};
+
+template <class Carga, int MaxHijos>
+struct ArbolGenerico {
+    typedef NodoGenerico<Carga, MaxHijos> NodoT;
+    typedef typename NodoT::Enlaces Enlaces;
+    static const bool LIMITADO = MaxHijos > 0; // Con límite hay que llevar la cuenta de quién tiene lugar
+    static const size_t NODOS_POR_BLOQUE = 4096;
+
+    // Orden BFS: generación y, dentro de ella, el orden de los padres y después el lugar entre los
+    // hermanos. Sube por los dos caminos hasta que comparten el padre: O(profundidad), sin etiquetas
+    // que mantener. Un nodo se compara mientras sigue colgado de su padre.
+    struct PorNivel {
+        bool operator()(const NodoT* a, const NodoT* b) const {
+            if (a->profundidad != b->profundidad) return a->profundidad < b->profundidad;
+            while (a != b && a->padre != b->padre) { a = a->padre; b = b->padre; }
+            return a != b && Enlaces::lugar(a) < Enlaces::lugar(b);
+        }
+    };
+
+    NodoT* raiz;
+    size_t cantidad;           // Nodos vivos
+    set<NodoT*, PorNivel> libres; // Solo con MaxHijos > 0: nodos con lugar para otro hijo, en orden BFS
+    vector<void*> bloques;     // Memoria de los nodos, reservada por bloques
+    size_t usadosBloque;       // Casillas ya entregadas del último bloque
+    vector<NodoT*> sueltos;    // Casillas de nodos quitados, para reusar
+
+    explicit ArbolGenerico(const Carga& cargaRaiz) : raiz(NULL), cantidad(0), usadosBloque(NODOS_POR_BLOQUE) {
+        raiz = crear(cargaRaiz, NULL);
+        if (LIMITADO) libres.insert(raiz);
+    }
+
+    ~ArbolGenerico() {
+        vector<NodoT*> vivos; // Primero se juntan: el recorrido lee padres y hermanos que no pueden estar destruidos
+        vivos.reserve(cantidad);
+        recorrer(raiz, PREORDEN, [&](NodoT* n) { vivos.push_back(n); });
+        for (size_t i = 0; i < vivos.size(); i++) vivos[i]->~NodoT();
+        for (size_t i = 0; i < bloques.size(); i++) ::operator delete(bloques[i]);
+    }
+
+    ArbolGenerico(const ArbolGenerico&) = delete;
+    ArbolGenerico& operator=(const ArbolGenerico&) = delete;
+
+    NodoT* crear(const Carga& c, NodoT* padre) {
+        void* casilla;
+        if (!sueltos.empty()) { casilla = sueltos.back(); sueltos.pop_back(); }
+        else {
+            if (usadosBloque == NODOS_POR_BLOQUE) { bloques.push_back(::operator new(NODOS_POR_BLOQUE * sizeof(NodoT))); usadosBloque = 0; }
+            casilla = (NodoT*)bloques.back() + usadosBloque++;
+        }
+        cantidad++;
+        return new (casilla) NodoT(c, padre);
+    }
+
+    // Agrega un hijo al final de la familia de 'padre'; devuelve NULL si el padre ya está lleno
+    NodoT* insertar(NodoT* padre, const Carga& c) {
+        if (Enlaces::lleno(padre)) return NULL;
+        NodoT* n = crear(c, padre);
+        Enlaces::agregar(padre, n);
+        if (LIMITADO) {
+            if (Enlaces::lleno(padre)) libres.erase(padre); // El padre se llenó
+            libres.insert(n);
+        }
+        return n;
+    }
+
+    // Quita un nodo sin hijos (la raíz no se quita); devuelve false si no se pudo
+    bool quitarHoja(NodoT* n) {
+        if (n == raiz || n->hijos() > 0) return false;
+        NodoT* padre = n->padre;
+        if (LIMITADO) libres.erase(n); // Antes de soltarlo: PorNivel busca su lugar en la familia
+        Enlaces::quitar(padre, n);
+        if (LIMITADO) libres.insert(padre); // Ahora tiene lugar (si ya estaba, no cambia nada)
+        n->~NodoT();
+        sueltos.push_back(n);
+        cantidad--;
+        return true;
+    }
+
+    // El primer nodo en orden BFS que acepta otro hijo (sin límite, siempre la raíz)
+    NodoT* primerPadreDisponible() const {
+        if (!LIMITADO) return raiz;
+        return libres.empty() ? NULL : *libres.begin();
+    }
+
+    // Todos los nodos que aceptan otro hijo, en orden BFS
+    vector<NodoT*> padresDisponibles() const {
+        if (LIMITADO) return vector<NodoT*>(libres.begin(), libres.end());
+        vector<NodoT*> todos(1, raiz); // Sin límite todos aceptan: BFS usando el mismo vector como cola
+        for (size_t i = 0; i < todos.size(); i++)
+            for (NodoT* h = todos[i]->primerHijo(); h; h = h->siguienteHermano()) todos.push_back(h);
+        return todos;
+    }
+
+    // Igual que el motor de recorridos de Arbol: sin recursión ni pila, con los punteros al padre.
+    // En INORDEN el nodo se visita después del subárbol de su primer hijo.
+    template <class Visitante>
+    static void recorrer(NodoT* inicio, OrdenRecorrido orden, Visitante visitar) {
+        NodoT* actual = inicio;
+        NodoT* previo = NULL; // Hijo del que se acaba de volver (NULL: se llegó bajando)
+        while (actual) {
+            NodoT* siguiente;
+            if (!previo) {                        // Se bajó a este nodo por primera vez
+                if (orden == PREORDEN) visitar(actual);
+                siguiente = actual->primerHijo();
+                if (!siguiente && orden == INORDEN) visitar(actual);
+            } else {                              // Se volvió del subárbol de 'previo'
+                if (orden == INORDEN && previo == actual->primerHijo()) visitar(actual);
+                siguiente = Enlaces::siguienteHermano(previo);
+            }
+            if (siguiente) { previo = NULL; actual = siguiente; continue; }
+            if (orden == POSTORDEN) visitar(actual);
+            if (actual == inicio) break;          // El recorrido termina al salir de 'inicio'
+            previo = actual;
+            actual = actual->padre;
+        }
+    }
+};
+#endif // ARBOL_GENERICO
+
+// --------------------------------------
+// AGREGADOS POR SUBÁRBOL
+// --------------------------------------
+// Contadores de todo el subárbol de un nodo (el nodo incluido). Viven en un arreglo aparte
+// indexado por id para que Nodo siga ocupando 64 bytes.
+struct Agregado {
+    unsigned int tamano;             // Cantidad de nodos del subárbol
+    unsigned int porTipoEstado[3][2]; // [Tipo][Estado]: por ejemplo Fuego vivos
+    unsigned int porGenero[3];       // [Genero]
+    int altura;                      // Aristas hasta la hoja más profunda (una hoja tiene altura 0)
+    int hueco;                       // Generaciones hasta el nodo con lugar para otro hijo más cercano (0: el propio nodo)
+
+    Agregado() { memset(this, 0, sizeof(*this)); }
+
+    void sumarNodo(const Nodo* n, int signo) { // Suma (o resta) los atributos de un solo nodo
+        tamano += signo;
+        porTipoEstado[n->tipo][n->estado] += signo;
+        porGenero[n->genero] += signo;
+    }
+
+    void sumar(const Agregado& o) { // Suma los contadores de un subárbol hijo
+        tamano += o.tamano;
+        for (int t = 0; t < 3; t++)
+            for (int e = 0; e < 2; e++) porTipoEstado[t][e] += o.porTipoEstado[t][e];
+        for (int g = 0; g < 3; g++) porGenero[g] += o.porGenero[g];
+    }
+};
+
+// --------------------------------------
+// ÁRBOL GENEALÓGICO
+// --------------------------------------
+struct Arbol {
+    // Compara nodos por generación y, dentro de la generación, por su posición en el recorrido BFS
+    struct PorNivel {
+        bool operator()(const Nodo* a, const Nodo* b) const {
+            if (a->profundidad != b->profundidad) return a->profundidad < b->profundidad;
+            return a->orden < b->orden;
+        }
+    };
+
+    // Compara hojas por momento de nacimiento (las más viejas primero); el id desempata
+    struct PorNacimiento {
+        bool operator()(const Nodo* a, const Nodo* b) const {
+            if (a->nacimiento != b->nacimiento) return a->nacimiento < b->nacimiento;
+            return a->id < b->id;
+        }
+    };
+
+    static const int EDAD_ELIMINABLE = 60; // "Años" que debe cumplir una hoja para poder eliminarse
+
+    PoolNodos pool; // Memoria de todos los nodos del árbol (se declara primero para destruirse al final)
+    ArenaNombres nombres; // Memoria de los nombres de todos los nodos
+    ListaRetiro retiro; // Nodos y tablas quitados que esperan a que ningún lector los vea
+    Enlace raiz;  // El nodo raíz del árbol (siempre "Asteroide")
+    IndiceNombres indice; // Índice hash nombre -> Nodo* (se mantiene al insertar y eliminar)
+    NombresOrdenados ordenNombres; // Los mismos nodos en orden alfabético (prefijos, rangos, parecidos)
+    IndiceAtributos atributos;     // Mapas de bits de ids por tipo, género y estado
+    set<Nodo*, PorNivel> libres;   // Nodos con menos de MAX_HIJOS hijos (padres disponibles), en orden BFS
+    set<Nodo*, PorNivel> conHijos; // Nodos con al menos un hijo, en orden BFS (ubican a cada hijo nuevo en su generación)
+    set<Nodo*, PorNacimiento> hojas; // Nodos sin hijos, de la más vieja a la más nueva (las eliminables van al principio)
+    ArchivoMapeado instantanea;    // Última instantánea cargada (los nombres de sus nodos apuntan dentro de ella)
+    Bitacora* bitacora;            // Bitácora donde se registra cada cambio (NULL si no se usa)
+    HistorialVersiones* historial; // Versiones para deshacer y consultar el pasado (NULL si no se usa)
+    vector<Agregado> agregados;    // Contadores del subárbol de cada nodo, por id
+    mutex escritura;               // Cerrojo de los escritores (los lectores no lo usan, ver GuardiaLectura); solo lo toma el benchmark concurrente
+    bool agregadosDiferidos;       // true: los cambios no recorren los ancestros (cargas masivas)
+    bool agregadosSucios;          // true: 'agregados' está viejo y se recalcula en la próxima consulta
+    PoliticaUbicacion politica;    // Cómo se elige el padre en INSERT ... AUTO
+    unsigned long turnoLinaje;     // Cuántos personajes ubicó la política por linajes (elige el próximo linaje)
+
+    // Constructor del árbol: se ejecuta al crear un objeto Arbol
+    Arbol() {
+        bitacora = NULL;
+        historial = NULL;
+        indice.retiro = &retiro; // Las tablas viejas del índice esperan a los lectores
+        agregadosDiferidos = false;
+        agregadosSucios = false;
+        politica = UBICAR_NIVEL;
+        turnoLinaje = 0;
+        crearInicial();
+    }
+
+    // Destructor: devuelve toda la memoria de los nodos
+    ~Arbol() {
+        destruirNodos();
+    }
+
+    Arbol(const Arbol&) = delete;            // El árbol es dueño de sus nodos: no se copia
+    Arbol& operator=(const Arbol&) = delete;
+
+    // Crea el árbol inicial: Asteroide con sus hijos Agua y Fuego
+    void crearInicial() {
+        raiz = pool.crear(nombres.guardar("Asteroide", 9), 9, TIPO_ROCA, GENERO_NINGUNO, ESTADO_VIVO, NULL); // Crea el nodo raíz (sin padre)
+        raiz->orden = 1ULL << 63; // La raíz queda a la mitad del rango de etiquetas
+        indice.insertar(raiz); // Registra la raíz en el índice de nombres
+        ordenNombres.insertar(raiz);
+        atributos.agregar(raiz);
+        libres.insert(raiz);   // La raíz empieza sin hijos: es un padre disponible
+        hojas.insert(raiz);
+        agregadoNuevo(raiz);
+        enlazarNuevo("Agua", 4, TIPO_AGUA, GENERO_NINGUNO, ESTADO_MUERTO, raiz);    // Crea el hijo izquierdo inicial
+        enlazarNuevo("Fuego", 5, TIPO_FUEGO, GENERO_NINGUNO, ESTADO_MUERTO, raiz);  // Crea el hijo derecho inicial
+    }
+
+    // Libera todos los nodos en O(cantidad de bloques): Nodo no tiene destructor que llamar
+    void destruirNodos() {
+        static_assert(is_trivially_destructible<Nodo>::value, "Nodo debe poder descartarse sin destructor");
+        retiro.liberarTodo(); // Se asume que ya no hay lectores
+        pool.reiniciar();
+        nombres.reiniciar();
+        instantanea.cerrar();
+        raiz = NULL;
+    }
+
+    // Deja el árbol sin ningún nodo (ni siquiera la raíz) y con todos sus índices vacíos
+    void vaciar() {
+        destruirNodos();
+        indice.reiniciar();
+        ordenNombres.reiniciar();
+        atributos.reiniciar();
+        libres.clear();
+        conHijos.clear();
+        hojas.clear();
+        agregados.clear();
+        agregadosSucios = false;
+    }
+
+    // Vuelve al árbol inicial descartando todos los personajes
+    void reiniciar() {
+        vaciar();
+        crearInicial();
+        if (historial) historial->comenzar(raiz); // Las versiones viejas no corresponden al árbol nuevo
+    }
+
+    // Función para buscar un nodo por su nombre usando el índice hash (O(1) promedio)
+    Nodo* buscar(const string& nombre) {
+        return buscar(nombre.data(), nombre.size());
+    }
+    Nodo* buscar(const char* nombre, size_t largo) {
+        MedirOperacion medir(OP_BUSCAR);
+        return indice.buscar(nombre, largo);
+    }
+
+    // Búsqueda original por niveles (BFS); se conserva como referencia para el benchmark
+    Nodo* buscarBFS(const string& nombre) {
+        if (raiz == NULL) return NULL; // Si el árbol está vacío, retorna NULL
+        queue<Nodo*> q;  // Declara una cola de punteros a Nodo para BFS (Breadth-First Search)
+        q.push(raiz);    // Inserta el nodo raíz para comenzar el recorrido
+        while (!q.empty()) {   // Repite mientras la cola no esté vacía
+            Nodo* act = q.front();  // Obtiene el nodo al frente de la cola
+            q.pop();             // Elimina el nodo del frente de la cola
+            if (act->tieneNombre(nombre.data(), nombre.size())) return act; // Si el nombre coincide, retorna el nodo encontrado
+            if (act->izquierda) q.push(act->izquierda); // Si tiene hijo izquierdo, lo agrega a la cola
+            if (act->derecha) q.push(act->derecha);      // Si tiene hijo derecho, lo agrega a la cola
+        }
+        return NULL; // Si el bucle termina sin encontrar el nodo, retorna NULL
+    }
+
+    // Función que devuelve una lista (vector) de todos los nodos que pueden tener al menos un hijo más (menos de MAX_HIJOS hijos).
+    // Se copia del conjunto 'libres', que ya está en orden BFS, sin recorrer el árbol.
+    vector<Nodo*> padresDisponibles() {
+        MedirOperacion medir(OP_PADRES_DISPONIBLES);
+        return vector<Nodo*>(libres.begin(), libres.end());
+    }
+
+    // Devuelve el primer padre disponible en orden BFS (el de menor generación), o NULL si no hay
+    Nodo* primerPadreDisponible() {
+        return libres.empty() ? NULL : *libres.begin();
+    }
+
+    // Busca los nodos que quedarán justo antes ('ant') y justo después ('sig') de un hijo nuevo de 'padre'
+    // dentro de su generación, usando los nodos con hijos de la generación del padre
+    void vecinosNuevoHijo(Nodo* padre, bool esIzquierdo, Nodo*& ant, Nodo*& sig) {
+        ant = NULL;
+        sig = NULL;
+        if (!esIzquierdo && padre->izquierda) ant = padre->izquierda; // El hermano izquierdo va justo antes
+        else {
+            set<Nodo*, PorNivel>::iterator it = conHijos.lower_bound(padre);
+            if (it != conHijos.begin()) {
+                --it; // Nodo con hijos más cercano a la izquierda del padre
+                if ((*it)->profundidad == padre->profundidad) ant = (*it)->derecha ? (*it)->derecha : (*it)->izquierda;
+            }
+        }
+        if (esIzquierdo && padre->derecha) sig = padre->derecha; // El hermano derecho va justo después
+        else {
+            set<Nodo*, PorNivel>::iterator it = conHijos.upper_bound(padre); // Nodo con hijos más cercano a la derecha
+            if (it != conHijos.end() && (*it)->profundidad == padre->profundidad)
+                sig = (*it)->izquierda ? (*it)->izquierda : (*it)->derecha;
+        }
+    }
+
+    // Calcula la etiqueta de orden de un hijo nuevo de 'padre' (queda entre sus vecinos de generación)
+    unsigned long long etiquetaNuevoHijo(Nodo* padre, bool esIzquierdo) {
+        const unsigned long long PASO = 1ULL << 32; // Separación usada al agregar al principio o al final
+        while (true) {
+            Nodo* ant;
+            Nodo* sig;
+            vecinosNuevoHijo(padre, esIzquierdo, ant, sig);
+            if (!ant && !sig) return 1ULL << 63; // Primer nodo de la generación
+            unsigned long long bajo = ant ? ant->orden : 0;
+            unsigned long long alto = sig ? sig->orden : ULLONG_MAX;
+            if (alto - bajo >= 2) {
+                unsigned long long mitad = (alto - bajo) / 2;
+                if (!sig) return bajo + (mitad < PASO ? mitad : PASO); // Al final de la generación
+                if (!ant) return alto - (mitad < PASO ? mitad : PASO); // Al principio de la generación
+                return bajo + mitad;                                   // Entre dos nodos
+            }
+            reetiquetarGeneracion(padre); // No queda espacio entre los vecinos: se redistribuyen las etiquetas
+        }
+    }
+
+    // Reparte de nuevo, con separación uniforme, las etiquetas de la generación de los hijos de 'padre'.
+    // Es O(tamaño de la generación), pero solo ocurre cuando se agota el espacio entre dos etiquetas.
+    void reetiquetarGeneracion(Nodo* padre) {
+        set<Nodo*, PorNivel>::iterator it = conHijos.lower_bound(padre);
+        while (it != conHijos.begin()) { // Retrocede hasta el primer nodo con hijos de la generación del padre
+            set<Nodo*, PorNivel>::iterator previo = it;
+            --previo;
+            if ((*previo)->profundidad != padre->profundidad) break;
+            it = previo;
+        }
+        vector<Nodo*> generacion; // Hijos de esa generación, en orden BFS
+        for (; it != conHijos.end() && (*it)->profundidad == padre->profundidad; ++it) {
+            if ((*it)->izquierda) generacion.push_back((*it)->izquierda);
+            if ((*it)->derecha) generacion.push_back((*it)->derecha);
+        }
+        // Cambiar las etiquetas conserva el orden relativo, así que los conjuntos siguen siendo válidos
+        unsigned long long paso = ULLONG_MAX / (generacion.size() + 1);
+        for (size_t i = 0; i < generacion.size(); i++) generacion[i]->orden = paso * (i + 1);
+    }
+
+    // Función que pide al usuario seleccionar el tipo ("Agua" o "Fuego") y lo retorna
+    Tipo elegirTipo() {
+        int op; // Variable para almacenar la opción del menú
+        cout << "\nTipo:\n1. Agua\n2. Fuego\nOpcion: ";
+        cin >> op;           // Lee la opción ingresada por el usuario
+        while (op < 1 || op > 2) { // Bucle de validación para asegurar que la opción es 1 o 2
+            cout << "Opcion invalida. Intente de nuevo: ";
+            cin >> op;
+        }
+        return (op == 1 ? TIPO_AGUA : TIPO_FUEGO); // Retorna Agua si es 1, o Fuego si es 2
+    }
+
+    // Función que pide al usuario seleccionar el género ("Hombre" o "Mujer") y lo retorna
+    Genero elegirGenero() {
+        int op;
+        cout << "\nGenero:\n1. Hombre\n2. Mujer\nOpcion: ";
+        cin >> op;
+        while (op < 1 || op > 2) {
+            cout << "Opcion invalida. Intente de nuevo: ";
+            cin >> op;
+        }
+        return (op == 1 ? GENERO_HOMBRE : GENERO_MUJER);
+    }
+
+    // Función que pide al usuario seleccionar el estado ("Vivo" o "Muerto") y lo retorna
+    Estado elegirEstado() {
+        int op;
+        cout << "\nEstado:\n1. Vivo\n2. Muerto\nOpcion: ";
+        cin >> op;
+        while (op < 1 || op > 2) {
+            cout << "Opcion invalida. Intente de nuevo: ";
+            cin >> op;
+        }
+        return (op == 1 ? ESTADO_VIVO : ESTADO_MUERTO);
+    }
+
+    // Crea un nodo y lo enlaza bajo 'padreSel' sin preguntar nada al usuario.
+    // Se asume que el nombre no existe y que el padre tiene menos de MAX_HIJOS hijos.
+    Nodo* insertarNodo(const string& nombre, Tipo tipo, Genero genero, Estado estado, Nodo* padreSel) {
+        return insertarNodo(nombre.data(), nombre.size(), tipo, genero, estado, padreSel);
+    }
+    Nodo* insertarNodo(const char* nombre, size_t largo, Tipo tipo, Genero genero, Estado estado, Nodo* padreSel) {
+        MedirOperacion medir(OP_INSERTAR);
+        Nodo* nuevo = enlazarNuevo(nombre, largo, tipo, genero, estado, padreSel);
+        if (bitacora) bitacora->registrarInsercion(nuevo); // Deja constancia en la bitácora
+        if (historial) historial->registrarInsercion(nuevo); // Y una versión nueva en el historial
+        return nuevo;
+    }
+
+    // Crea y enlaza el nodo manteniendo todos los índices, sin escribir en la bitácora
+    // (lo usan el árbol inicial y la recuperación, que no deben volver a registrarse).
+    // 'lado' elige el hijo (0 izquierdo, 1 derecho); con -1 se usa el primero libre.
+    // 'nacimiento' (si no es NACIMIENTO_AHORA) se fija antes de enlazar: los lectores nunca ven otro valor.
+    static const int NACIMIENTO_AHORA = INT_MIN;
+    Nodo* enlazarNuevo(const char* nombre, size_t largo, Tipo tipo, Genero genero, Estado estado, Nodo* padreSel, int lado = -1,
+                       int nacimiento = NACIMIENTO_AHORA) {
+        const char* guardado = nombres.guardar(nombre, largo); // Copia el nombre a la arena
+        Nodo* nuevo = pool.crear(guardado, (unsigned int)largo, tipo, genero, estado, padreSel); // Crea el nuevo nodo dentro del pool
+        if (nacimiento != NACIMIENTO_AHORA) nuevo->nacimiento = nacimiento; // Recuperado o restaurado: conserva su nacimiento
+        bool esIzquierdo = lado < 0 ? (padreSel->izquierda == NULL) : (lado == 0);
+        nuevo->orden = etiquetaNuevoHijo(padreSel, esIzquierdo); // Posición del nuevo nodo dentro de su generación
+
+        if (padreSel->hijos() == 0) { // El padre pasa a tener hijos
+            conHijos.insert(padreSel);
+            hojas.erase(padreSel);
+        }
+        if (esIzquierdo) padreSel->izquierda = nuevo; // Si el hijo izquierdo está libre, asigna el nuevo nodo como izquierdo
+        else padreSel->derecha = nuevo; // Si no, asigna el nuevo nodo como hijo derecho
+        if (padreSel->hijos() == MAX_HIJOS) libres.erase(padreSel); // El padre se llenó: deja de estar disponible
+        libres.insert(nuevo); // El nuevo nodo no tiene hijos: es un padre disponible
+        hojas.insert(hojas.end(), nuevo); // Casi siempre es el más nuevo: la pista evita buscar
+
+        indice.insertar(nuevo); // Registra el nombre en el índice hash
+        ordenNombres.insertar(nuevo);
+        atributos.agregar(nuevo);
+        agregadoNuevo(nuevo);   // Suma el nodo en los contadores de sus ancestros
+        return nuevo;
+    }
+
+    // Devuelve el motivo por el que 'objetivo' no puede eliminarse, o NULL si sí puede
+    const char* motivoNoEliminable(Nodo* objetivo) {
+        if (objetivo == raiz) return "No puedes eliminar la raiz (Asteroide)."; // Comprueba si el nodo es la raíz
+        if (objetivo->hijos() > 0) return "No se puede eliminar, tiene hijos.";  // Comprueba si el nodo tiene hijos
+        if (objetivo->edadActual() < EDAD_ELIMINABLE) return "Solo puede eliminarse si tiene mas de 60 anios."; // Comprueba si tiene al menos 60 "años"
+        return NULL;
+    }
+
+    // Agrega a 'salida' las hojas que hoy pueden eliminarse, de la más vieja a la más nueva.
+    // Solo recorre el principio del conjunto 'hojas': el costo depende de cuántas hay, no del árbol.
+    size_t hojasEliminables(vector<Nodo*>& salida) {
+        int limite = yearsElapsed() - EDAD_ELIMINABLE; // Nacidas en este momento o antes ya cumplen la edad
+        size_t antes = salida.size();
+        for (set<Nodo*, PorNacimiento>::iterator it = hojas.begin(); it != hojas.end() && (*it)->nacimiento <= limite; ++it)
+            if (*it != raiz) salida.push_back(*it); // La raíz nunca se elimina
+        return salida.size() - antes;
+    }
+
+    // Elimina todas las hojas que hoy pueden eliminarse. Los padres que se quedan sin hijos
+    // no se eliminan en la misma pasada (aunque sean viejos): eso le toca a la siguiente.
+    size_t eliminarEliminables() {
+        vector<Nodo*> objetivos;
+        hojasEliminables(objetivos);
+        for (size_t i = 0; i < objetivos.size(); i++) eliminarNodo(objetivos[i]);
+        return objetivos.size();
+    }
+
+    // ---------------------------
+    // PARENTESCO (ancestros con punteros de salto)
+    // ---------------------------
+    // Ancestro de 'n' en la generación 'nivel' (n mismo si ya está ahí). O(log n) pasos:
+    // se usa el salto mientras no se pase del nivel buscado y, si no, se sube al padre.
+    Nodo* ancestroEnNivel(Nodo* n, int nivel) {
+        if (nivel < 0 || nivel > n->profundidad) return NULL;
+        while (n->profundidad > nivel) {
+            Nodo* j = pool.nodo(n->salto);
+            n = (j->profundidad >= nivel) ? j : n->padre;
+        }
+        return n;
+    }
+
+    // Ancestro común más cercano (un nodo es ancestro común de sí mismo)
+    Nodo* ancestroComun(Nodo* a, Nodo* b) {
+        if (a->profundidad > b->profundidad) a = ancestroEnNivel(a, b->profundidad);
+        else b = ancestroEnNivel(b, a->profundidad);
+        // Misma generación: los saltos de a y b llegan a la misma generación, así que se
+        // toma el salto si todavía no coinciden y, si coinciden, se sube de a un padre
+        while (a != b) {
+            if (a->salto != b->salto) { a = pool.nodo(a->salto); b = pool.nodo(b->salto); }
+            else { a = a->padre; b = b->padre; }
+        }
+        return a;
+    }
+
+    // Cantidad de aristas entre a y b (coincide con el grado de parentesco por consanguinidad)
+    int distancia(Nodo* a, Nodo* b) {
+        Nodo* c = ancestroComun(a, b);
+        return a->profundidad + b->profundidad - 2 * c->profundidad;
+    }
+
+    // true si 'x' es ancestro de 'y' (padre, abuelo, ...); un nodo no es ancestro de sí mismo
+    bool esAncestro(Nodo* x, Nodo* y) {
+        return x->profundidad < y->profundidad && ancestroEnNivel(y, x->profundidad) == x;
+    }
+
+    // Describe qué es 'a' de 'b' ("abuela", "primo de grado 2", ...)
+    string parentesco(Nodo* a, Nodo* b) {
+        Nodo* c = ancestroComun(a, b);
+        int subeA = a->profundidad - c->profundidad; // Generaciones de a hasta el ancestro común
+        int subeB = b->profundidad - c->profundidad; // Generaciones de b hasta el ancestro común
+        bool mujer = (a->genero == GENERO_MUJER);
+        static const char* const ANCESTROS[][2]    = { {"padre", "madre"}, {"abuelo", "abuela"}, {"bisabuelo", "bisabuela"}, {"tatarabuelo", "tatarabuela"} };
+        static const char* const DESCENDIENTES[][2] = { {"hijo", "hija"}, {"nieto", "nieta"}, {"bisnieto", "bisnieta"}, {"tataranieto", "tataranieta"} };
+        if (subeA == 0 && subeB == 0) return "la misma persona";
+        if (subeA == 0) return subeB <= 4 ? ANCESTROS[subeB - 1][mujer] : "ancestro de " + to_string(subeB) + " generaciones";
+        if (subeB == 0) return subeA <= 4 ? DESCENDIENTES[subeA - 1][mujer] : "descendiente de " + to_string(subeA) + " generaciones";
+        if (subeA == 1 && subeB == 1) return mujer ? "hermana" : "hermano";
+        if (subeA == 1) return string(mujer ? "tia" : "tio") + (subeB > 2 ? " de " + to_string(subeB - 1) + " generaciones" : "");
+        if (subeB == 1) return string(mujer ? "sobrina" : "sobrino") + (subeA > 2 ? " de " + to_string(subeA - 1) + " generaciones" : "");
+        string r = string(mujer ? "prima" : "primo") + " de grado " + to_string(min(subeA, subeB) - 1);
+        int diferencia = abs(subeA - subeB);
+        if (diferencia) r += " con " + to_string(diferencia) + (diferencia == 1 ? " generacion" : " generaciones") + " de diferencia";
+        return r;
+    }
+
+    // Pide dos nombres y muestra su parentesco
+    void mostrarParentesco() {
+        string n1, n2;
+        cout << "\nPrimer personaje: ";
+        cin >> n1;
+        cout << "Segundo personaje: ";
+        cin >> n2;
+        Nodo* a = buscar(n1);
+        Nodo* b = buscar(n2);
+        if (!a || !b) { cout << "No existe " << (a ? n2 : n1) << ".\n"; return; }
+        Nodo* c = ancestroComun(a, b);
+        cout << colorNodo(a) << " es " << parentesco(a, b) << " de " << colorNodo(b)
+             << " (grado " << distancia(a, b) << ", ancestro comun: " << colorNodo(c) << ")\n";
+    }
+
+    // ---------------------------
+    // AGREGADOS POR SUBÁRBOL
+    // ---------------------------
+    // Un nodo recién enlazado (siempre hoja) se suma a sí mismo y a cada ancestro: O(profundidad).
+    void agregadoNuevo(Nodo* n) {
+        if (agregadosDiferidos || agregadosSucios) { agregadosSucios = true; return; } // Se recalcula todo en la próxima consulta
+        if (agregados.size() < pool.usadas) agregados.resize(pool.usadas);
+        agregados[n->id] = Agregado();
+        agregados[n->id].sumarNodo(n, 1);
+        int altura = 0;
+        bool huecoCambia = true;
+        for (Nodo* a = n->padre; a; a = a->padre) {
+            Agregado& g = agregados[a->id];
+            g.sumarNodo(n, 1);
+            altura++;
+            if (g.altura < altura) g.altura = altura;
+            if (huecoCambia) { // Solo el padre puede llenarse; más arriba cambia mientras cambie el de abajo
+                int hueco = huecoDe(a);
+                huecoCambia = (hueco != g.hueco);
+                g.hueco = hueco;
+            }
+        }
+    }
+
+    // Distancia al lugar libre más cercano del subárbol de 'a' según los agregados de sus hijos
+    int huecoDe(Nodo* a) {
+        if (a->hijos() < MAX_HIJOS) return 0;
+        return 1 + min(agregados[a->izquierda->id].hueco, agregados[a->derecha->id].hueco);
+    }
+
+    // Una hoja ya desenganchada de 'padre' se resta de sus ancestros. La altura y el hueco se
+    // recalculan con los hijos que quedan mientras sigan cambiando.
+    void agregadoQuitado(Nodo* n, Nodo* padre) {
+        if (agregadosDiferidos || agregadosSucios) { agregadosSucios = true; return; }
+        bool alturaCambia = true;
+        bool huecoCambia = true;
+        for (Nodo* a = padre; a; a = a->padre) {
+            Agregado& g = agregados[a->id];
+            g.sumarNodo(n, -1);
+            if (alturaCambia) {
+                int altura = 0;
+                if (a->izquierda) altura = agregados[a->izquierda->id].altura + 1;
+                if (a->derecha) altura = max(altura, agregados[a->derecha->id].altura + 1);
+                alturaCambia = (altura != g.altura);
+                g.altura = altura;
+            }
+            if (huecoCambia) {
+                int hueco = huecoDe(a);
+                huecoCambia = (hueco != g.hueco);
+                g.hueco = hueco;
+            }
+        }
+    }
+
+    // Un nodo que cambia de estado se mueve de casilla en su contador y en el de cada ancestro
+    void agregadoEstado(Nodo* n, Estado nuevo) {
+        if (agregadosDiferidos || agregadosSucios) { agregadosSucios = true; return; }
+        for (Nodo* a = n; a; a = a->padre) {
+            Agregado& g = agregados[a->id];
+            g.porTipoEstado[n->tipo][n->estado]--;
+            g.porTipoEstado[n->tipo][nuevo]++;
+        }
+    }
+
+    // Recalcula todos los contadores en una sola pasada en postorden: O(n)
+    void recalcularAgregados() {
+        agregados.assign(pool.usadas, Agregado());
+        recorrer(raiz, POSTORDEN, [&](Nodo* n) {
+            Agregado& g = agregados[n->id];
+            g.sumarNodo(n, 1);
+            if (n->izquierda) { g.sumar(agregados[n->izquierda->id]); g.altura = agregados[n->izquierda->id].altura + 1; }
+            if (n->derecha) { g.sumar(agregados[n->derecha->id]); g.altura = max(g.altura, agregados[n->derecha->id].altura + 1); }
+            g.hueco = huecoDe(n);
+        });
+        agregadosSucios = false;
+    }
+
+    // Con 'diferir' los cambios dejan de recorrer los ancestros (para cargas masivas o cadenas
+    // muy profundas); al volver al modo normal los contadores se recalculan una vez si hace falta.
+    void diferirAgregados(bool diferir) {
+        agregadosDiferidos = diferir;
+        if (!diferir && agregadosSucios) recalcularAgregados();
+    }
+
+    // Contadores del subárbol de 'n' en O(1) (salvo la primera consulta después de una carga diferida)
+    const Agregado& agregadoDe(Nodo* n) {
+        if (agregadosSucios) recalcularAgregados();
+        return agregados[n->id];
+    }
+
+    // Escribe en una línea los contadores del subárbol de 'n'
+    void escribirAgregado(ostream& out, Nodo* n) {
+        const Agregado& g = agregadoDe(n);
+        out << n->nombre << ": tamano " << g.tamano << " | altura " << g.altura;
+        for (int t = 0; t < 3; t++)
+            for (int e = 0; e < 2; e++)
+                out << " | " << TEXTO_TIPO[t] << " " << TEXTO_ESTADO[e] << " " << g.porTipoEstado[t][e];
+        for (int ge = 0; ge < 3; ge++) out << " | " << TEXTO_GENERO[ge] << " " << g.porGenero[ge];
+        out << "\n";
+    }
+
+    // Pide un nombre y muestra las estadísticas de su linaje (el personaje incluido)
+    void mostrarEstadisticas() {
+        string nombre;
+        cout << "\nNombre del personaje: ";
+        cin >> nombre;
+        Nodo* n = buscar(nombre);
+        if (!n) { cout << "No existe ese personaje.\n"; return; }
+        escribirAgregado(cout, n);
+    }
+
+    // Cambia el estado (Vivo/Muerto) de un personaje dejando constancia en la bitácora
+    void cambiarEstado(Nodo* n, Estado nuevo) {
+        if (n->estado == nuevo) return;
+        if (bitacora) bitacora->registrarEstado(n, nuevo);
+        if (historial) historial->registrarEstado(n, nuevo);
+        aplicarEstado(n, nuevo);
+    }
+
+    // Cambia el estado manteniendo los mapas de bits y los contadores, sin escribir en la bitácora.
+    // Un lector concurrente ve el estado viejo o el nuevo (EstadoCompartido); los mapas de bits y los
+    // agregados no se publican junto con él, así que una consulta simultánea puede verlos un paso atrás.
+    void aplicarEstado(Nodo* n, Estado nuevo) {
+        if (n->estado == nuevo) return;
+        atributos.cambiarEstado(n, nuevo);
+        agregadoEstado(n, nuevo);
+        n->estado = nuevo;
+    }
+
+    // Desconecta y libera una hoja (se asume que ya se validó que puede eliminarse)
+    void eliminarNodo(Nodo* objetivo) {
+        MedirOperacion medir(OP_ELIMINAR);
+        if (bitacora) bitacora->registrarEliminacion(objetivo); // Deja constancia en la bitácora
+        if (historial) historial->registrarEliminacion(objetivo); // Antes de quitarla: el camino sale de sus padres
+        quitarHoja(objetivo);
+    }
+
+    static void liberarNodo(void* pool, void* nodo) { ((PoolNodos*)pool)->liberar((Nodo*)nodo); }
+
+    // Desconecta y libera una hoja manteniendo los índices, sin escribir en la bitácora
+    void quitarHoja(Nodo* objetivo) {
+        Nodo* padre = objetivo->padre;
+        libres.erase(objetivo); // Una hoja siempre estaba entre los padres disponibles
+        hojas.erase(objetivo);
+
+        // Desconectamos nodo del padre
+        if (padre->izquierda == objetivo) // Si el objetivo es el hijo izquierdo de su padre
+            padre->izquierda = NULL; // El padre apunta a NULL en su izquierda
+        else // Si es el hijo derecho
+            padre->derecha = NULL; // El padre apunta a NULL en su derecha
+
+        if (padre->hijos() == 0) { // El padre se quedó sin hijos: ahora es una hoja
+            conHijos.erase(padre);
+            hojas.insert(padre);
+        }
+        libres.insert(padre); // El padre vuelve a tener espacio (si ya estaba, no cambia nada)
+
+        indice.quitar(objetivo); // Quita el nombre del índice hash
+        ordenNombres.quitar(objetivo);
+        atributos.quitar(objetivo);
+        agregadoQuitado(objetivo, padre); // Resta el nodo de los contadores de sus ancestros
+        retiro.retirar(liberarNodo, &pool, objetivo); // La casilla vuelve al pool cuando ningún lector pueda verla
+    }
+
+    // ---------------------------
+    // UBICACIÓN AUTOMÁTICA (INSERT ... AUTO)
+    // ---------------------------
+    // Ninguna política recorre el árbol: "nivel" toma el primero de 'libres' (ya ordenado por
+    // generación) y las otras bajan desde la raíz una generación por paso guiadas por los
+    // agregados: O(profundidad), que al ubicar así se mantiene en O(log n).
+
+    // Baja desde 'n' hasta el lugar libre menos profundo de su subárbol siguiendo 'hueco'.
+    // A igual distancia va a la izquierda: elige el primero en orden BFS de esa generación.
+    Nodo* huecoMasCercano(Nodo* n) {
+        while (n->hijos() >= MAX_HIJOS) {
+            int buscado = agregados[n->id].hueco - 1;
+            n = agregados[n->izquierda->id].hueco == buscado ? (Nodo*)n->izquierda : (Nodo*)n->derecha;
+        }
+        return n;
+    }
+
+    // Padre para un personaje nuevo según 'politica'; NULL si no hay ninguno
+    Nodo* elegirPadre() {
+        if (libres.empty()) return NULL;
+        if (politica == UBICAR_NIVEL) return primerPadreDisponible();
+        if (agregadosDiferidos) diferirAgregados(false); // Estas políticas leen los agregados: se mantienen al día desde ahora
+        else if (agregadosSucios) recalcularAgregados();
+        Nodo* n = raiz;
+        if (n->hijos() < MAX_HIJOS) return n; // A la raíz le falta un linaje
+        if (politica == UBICAR_LINAJES) // Un linaje por turno (Agua, Fuego, Agua...) y en él, el lugar menos profundo
+            return huecoMasCercano(turnoLinaje++ % MAX_HIJOS == 0 ? (Nodo*)n->izquierda : (Nodo*)n->derecha);
+        while (n->hijos() >= MAX_HIJOS) { // UBICAR_POBLACION: el hijo con menos personajes (a igualdad, el izquierdo)
+            Nodo* izquierdo = n->izquierda;
+            Nodo* derecho = n->derecha;
+            n = agregados[derecho->id].tamano < agregados[izquierdo->id].tamano ? derecho : izquierdo;
+        }
+        return n;
+    }
+
+    // Pide la política con la que se ubican los personajes nuevos sin padre elegido
+    void elegirPolitica() {
+        cout << "\nPolitica actual: " << TEXTO_POLITICA[politica] << "\n";
+        cout << "1. nivel (el lugar libre menos profundo)\n";
+        cout << "2. linajes (por turnos entre los linajes de Agua y Fuego)\n";
+        cout << "3. poblacion (el subarbol con menos personajes)\n";
+        int op;
+        cin >> op;
+        if (op < 1 || op > 3) { cout << "Opcion invalida.\n"; return; }
+        politica = (PoliticaUbicacion)(op - 1);
+        cout << "Politica: " << TEXTO_POLITICA[politica] << "\n";
+    }
+
+    // ---------------------------
+    // VERSIONES (deshacer, rehacer, volver a una versión)
+    // ---------------------------
+    // Vuelve a crear un personaje de una versión anterior en el mismo lugar y con su nacimiento original
+    Nodo* restaurarNodo(const NodoVersion* v, Nodo* padre, int lado) {
+        Nodo* n = enlazarNuevo(v->nombre, v->largo, (Tipo)v->tipo, (Genero)v->genero, (Estado)v->estado, padre, lado, v->nacimiento);
+        if (bitacora) bitacora->registrarInsercion(n);
+        return n;
+    }
+
+    // Deja el árbol vivo igual a la versión 'numero'. Solo se aplican las diferencias con la versión
+    // actual (los subárboles compartidos ni se miran) y cada cambio pasa por la bitácora como cualquier
+    // otro, así que deshacer también sobrevive a un reinicio. No crea versiones: mueve el cursor.
+    bool irAVersion(unsigned long long numero, string& error) {
+        if (!historial) { error = "El historial de versiones esta desactivado."; return false; }
+        long destino = historial->posicion(numero);
+        if (destino < 0) { error = "No existe la version " + to_string(numero) + "."; return false; }
+        HistorialVersiones::Diferencias d;
+        HistorialVersiones::diferencias(historial->versiones[historial->actual].raiz, historial->versiones[destino].raiz, d);
+
+        HistorialVersiones* h = historial;
+        historial = NULL; // Los cambios de abajo no deben registrarse como versiones nuevas
+        for (size_t i = 0; i < d.quitados.size(); i++) // Hojas primero: cada una ya no tiene hijos al quitarla
+            eliminarNodo(buscar(d.quitados[i].nodo->nombre, d.quitados[i].nodo->largo));
+        for (size_t i = 0; i < d.agregados.size(); i++) { // Padres primero: el padre siempre ya existe
+            const HistorialVersiones::Cambio& c = d.agregados[i];
+            restaurarNodo(c.nodo, buscar(c.padre->nombre, c.padre->largo), c.lado);
+        }
+        for (size_t i = 0; i < d.estados.size(); i++)
+            cambiarEstado(buscar(d.estados[i].nodo->nombre, d.estados[i].nodo->largo), (Estado)d.estados[i].nodo->estado);
+        historial = h;
+        historial->actual = (size_t)destino;
+        return true;
+    }
+
+    // Deshace (pasos > 0) o rehace (pasos < 0) hasta 'pasos' cambios; devuelve cuántos se movió
+    long moverVersion(long pasos, string& error) {
+        if (!historial) { error = "El historial de versiones esta desactivado."; return -1; }
+        long destino = (long)historial->actual - pasos;
+        if (destino < 0) destino = 0;
+        if (destino > (long)historial->versiones.size() - 1) destino = (long)historial->versiones.size() - 1;
+        long movidos = (long)historial->actual - destino;
+        if (movidos != 0 && !irAVersion(historial->versiones[destino].numero, error)) return -1;
+        return movidos < 0 ? -movidos : movidos;
+    }
+
+    // Función principal para insertar un nuevo nodo en el árbol
+    void insertar() {
+        string nombre; // Variable para el nombre del nuevo personaje
+        cout << "\n=== Nueva insercion ===\n";
+        cout << "Nombre: ";
+        cin >> nombre;   // Pide y lee el nombre
+
+        if (buscar(nombre)) {   // Llama a buscar para verificar si el nombre ya existe
+            cout << "ERROR: Ya existe un personaje con ese nombre.\n";
+            return; // Termina la función si el nombre ya está en uso
+        }
+
+        Tipo tipo = elegirTipo();       // Pide y obtiene el tipo del nuevo nodo
+        Genero genero = elegirGenero(); // Pide y obtiene el género
+        Estado estado = elegirEstado(); // Pide y obtiene el estado
+
+        if (libres.empty()) {             // Verifica si hay padres disponibles
+            cout << "No hay padres disponibles.\n";
+            return; // Termina si no hay nodos con menos de 2 hijos
+        }
+        vector<Nodo*> disponibles = padresDisponibles(); // Obtiene la lista de nodos que pueden ser padres
+
+        // Muestra la lista de padres disponibles al usuario
+        cout << "\nSeleccione padre:\n";
+        cout << "0. Automatico (politica " << TEXTO_POLITICA[politica] << ")\n";
+        for (int i = 0; i < (int)disponibles.size(); i++) {
+            cout << (i+1) << ". " << disponibles[i]->nombre  // Imprime la opción numerada y el nombre del padre
+                 << " (hijos: " << disponibles[i]->hijos() << ")\n"; // Muestra la cantidad actual de hijos del potencial padre
+        }
+
+        int op; // Opción para seleccionar el padre
+        cin >> op;
+        if (op < 0 || op > (int)disponibles.size()) {  // Valida que la opción esté dentro del rango
+            cout << "Opcion invalida.\n";
+            return;
+        }
+
+        Nodo* padreSel = op == 0 ? elegirPadre() : disponibles[op-1]; // El padre elegido (índice op-1) o el de la política
+        insertarNodo(nombre, tipo, genero, estado, padreSel); // Crea y enlaza el nuevo nodo
+
+        cout << "Insertado correctamente bajo el padre: " << padreSel->nombre << "\n"; // Confirma la inserción
+    }
+
+    // Función para eliminar un nodo del árbol
+    void eliminar() {
+        string nombre;
+        cout << "\nNombre del personaje a eliminar: ";
+        cin >> nombre; // Pide el nombre a eliminar
+
+        Nodo* objetivo = buscar(nombre); // Busca el nodo por nombre
+        if (!objetivo) { // Si el resultado de buscar es NULL
+            cout << "No existe ese personaje.\n";
+            return; // Termina si no se encuentra
+        }
+
+        const char* motivo = motivoNoEliminable(objetivo); // Raíz, con hijos o menor de 60 "años"
+        if (motivo) {
+            cout << "ERROR: " << motivo << "\n";
+            return;
+        }
+
+        eliminarNodo(objetivo); // Desconecta el nodo de su padre y libera su memoria
+        cout << "Eliminado exitosamente.\n";
+    }
+
+    // Pide un personaje y su nuevo estado
+    void editarEstado() {
+        string nombre;
+        cout << "\nNombre del personaje: ";
+        cin >> nombre;
+        Nodo* n = buscar(nombre);
+        if (!n) { cout << "No existe ese personaje.\n"; return; }
+        cambiarEstado(n, elegirEstado());
+        cout << colorNodo(n) << " ahora esta " << n->estadoTexto() << ".\n";
+    }
+
+    // Pide un archivo CSV/TSV y reemplaza el árbol por sus personajes
+    void importarArchivo() {
+        if (bitacora) { cout << "No se puede importar con --journal activo (use --import al iniciar).\n"; return; }
+        string ruta, error;
+        cout << "\nArchivo CSV o TSV (nombre, tipo, genero, estado, padre[, nacimiento]): ";
+        cin >> ruta;
+        chrono::steady_clock::time_point inicio = chrono::steady_clock::now();
+        if (!importarCsv(ruta.c_str(), error)) { cout << "ERROR: " << error << "\n"; return; }
+        double segundos = chrono::duration<double>(chrono::steady_clock::now() - inicio).count();
+        cout << "Importados " << indice.vivos << " personajes en " << segundos << " s.\n";
+    }
+
+    // Deshace (o rehace) el último cambio y cuenta cuál fue
+    void deshacerUltimo(bool rehacer) {
+        string error;
+        size_t antes = historial ? historial->actual : 0;
+        long movidos = moverVersion(rehacer ? -1 : 1, error);
+        if (movidos < 0) { cout << "ERROR: " << error << "\n"; return; }
+        if (movidos == 0) { cout << (rehacer ? "No hay cambios para rehacer.\n" : "No hay cambios para deshacer.\n"); return; }
+        const HistorialVersiones::Version& v = historial->versiones[rehacer ? historial->actual : antes]; // La que tiene el cambio
+        cout << (rehacer ? "Rehecho: " : "Deshecho: ") << v.cambio << " (version actual: " << historial->numeroActual() << ")\n";
+    }
+
+    // Lista las últimas versiones y muestra por generaciones la que elija el usuario,
+    // con sus diferencias respecto del árbol de ahora
+    void verVersionAnterior() {
+        if (!historial) { cout << "El historial de versiones esta desactivado.\n"; return; }
+        cout << "\n=== VERSIONES ===\n";
+        size_t desde = historial->versiones.size() > 20 ? historial->versiones.size() - 20 : 0; // Solo las 20 más nuevas
+        for (size_t i = desde; i < historial->versiones.size(); i++)
+            cout << (i == historial->actual ? "* " : "  ") << historial->versiones[i].numero << "\t" << historial->versiones[i].cambio << "\n";
+        unsigned long long numero;
+        cout << "Version: ";
+        if (!(cin >> numero)) { cin.clear(); cin.ignore(1000, '\n'); return; }
+        const NodoVersion* r = historial->raizDe(numero);
+        if (!r) { cout << "No existe esa version.\n"; return; }
+        Salida s(cout);
+        HistorialVersiones::escribirGeneraciones(s, r, FORMATO_PLANO, yearsElapsed());
+        s.texto("\n=== CAMBIOS HASTA LA VERSION ACTUAL ===\n");
+        HistorialVersiones::Diferencias d;
+        HistorialVersiones::diferencias(r, historial->versiones[historial->actual].raiz, d);
+        HistorialVersiones::escribirDiferencias(s, d);
+    }
+
+    // Pide una consulta de atributos (por ejemplo "Agua AND Mujer AND NOT Muerto") y muestra
+    // cuántos personajes cumplen y los primeros de ellos
+    void filtrarPorAtributos() {
+        string consulta, error;
+        cout << "\nConsulta (Agua, Fuego, Roca, Hombre, Mujer, None, Vivo, Muerto con AND/OR/NOT y parentesis): ";
+        cin >> ws;
+        getline(cin, consulta);
+        MapaBits resultado;
+        if (!atributos.consultar(consulta.data(), consulta.size(), resultado, error)) { cout << "ERROR: " << error << "\n"; return; }
+        cout << "\n=== CUMPLEN: " << resultado.cantidad() << " ===\n";
+        size_t mostrados = 0;
+        resultado.recorrer([&](uint32_t id) { if (mostrados++ < 50) cout << colorNodo(pool.nodo(id)) << "\n"; });
+    }
+
+    // Muestra las hojas que ya cumplieron 60 "años" (las que se pueden eliminar ahora)
+    void listarEliminables() {
+        vector<Nodo*> lista;
+        hojasEliminables(lista);
+        cout << "\n=== PERSONAJES ELIMINABLES (" << lista.size() << ") ===\n";
+        int ahora = yearsElapsed();
+        for (size_t i = 0; i < lista.size(); i++)
+            cout << colorNodo(lista[i]) << " | Edad: " << ahora - lista[i]->nacimiento << "\n";
+    }
+
+    // Elimina de una vez todas las hojas eliminables
+    void eliminarTodosEliminables() {
+        size_t cantidad = eliminarEliminables();
+        cout << "Eliminados: " << cantidad << "\n";
+    }
+
+    // Busca personajes por el comienzo del nombre y también los de nombre parecido (errores de tipeo)
+    void buscarNombres() {
+        string texto;
+        cout << "\nNombre o comienzo del nombre: ";
+        cin >> texto;
+        const size_t MOSTRAR = 50; // Como mucho se listan estos por grupo
+        vector<Nodo*> lista;
+        ordenNombres.prefijo(texto.data(), texto.size(), lista, MOSTRAR);
+        cout << "\n=== EMPIEZAN CON " << texto << " (" << lista.size() << (lista.size() == MOSTRAR ? " o mas" : "") << ") ===\n";
+        for (size_t i = 0; i < lista.size(); i++) cout << colorNodo(lista[i]) << "\n";
+        lista.clear();
+        vector<unsigned int> distancias;
+        ordenNombres.parecidos(texto.data(), texto.size(), 2, lista, distancias);
+        cout << "\n=== PARECIDOS (" << lista.size() << ") ===\n";
+        for (size_t i = 0; i < lista.size() && i < MOSTRAR; i++)
+            cout << colorNodo(lista[i]) << " | Diferencias: " << distancias[i] << "\n";
+    }
+
+    // Una fila TSV con los datos de un nodo (mismas columnas que el encabezado de GEN TSV)
+    static void filaTSV(Salida& s, Nodo* nodo, int hijos, int ahora) {
+        s.entero(nodo->profundidad); s.caracter('\t');
+        s.texto(nodo->nombre, nodo->largo); s.caracter('\t');
+        s.texto(nodo->tipoTexto()); s.caracter('\t');
+        s.texto(nodo->generoTexto()); s.caracter('\t');
+        s.texto(nodo->estadoTexto()); s.caracter('\t');
+        if (nodo->padre) s.texto(nodo->padre->nombre, nodo->padre->largo); // Sin padre: campo vacío
+        s.caracter('\t');
+        s.entero(hijos); s.caracter('\t');
+        s.entero(ahora - nodo->nacimiento); s.caracter('\n');
+    }
+
+    // Función para mostrar el árbol por niveles o generaciones (utiliza BFS).
+    // Todo se arma en una Salida con búfer y la edad se calcula
+    // con una sola lectura del reloj para todo el volcado (no una por nodo).
+    void mostrarGeneraciones(ostream& out = cout, FormatoSalida formato = FORMATO_PLANO) {
+        MedirOperacion medir(OP_GENERACIONES);
+        GuardiaLectura guardia; // Se puede llamar desde un hilo lector mientras otro escribe
+        Salida s(out);
+        int ahora = yearsElapsed(); // Un único instante para todas las edades del volcado
+        if (formato == FORMATO_TSV) s.texto("generacion\tnombre\ttipo\tgenero\testado\tpadre\thijos\tedad\n");
+        else s.texto("\n=== ARBOL POR GENERACIONES ===\n");
+        vector<Nodo*> q;  // Cola BFS: un vector recorrido con un índice (el nivel ya está en cada nodo)
+        q.push_back(raiz);
+        int nivelActual = -1; // Variable para rastrear el nivel que se está imprimiendo
+        for (size_t i = 0; i < q.size(); i++) {
+            Nodo* nodo = q[i];
+            Nodo* izquierda = nodo->izquierda; // Cada enlace se lee una sola vez (otro hilo puede cambiarlo)
+            Nodo* derecha = nodo->derecha;
+            int hijos = (izquierda != NULL) + (derecha != NULL);
+            int nivel = nodo->profundidad;
+            if (formato == FORMATO_TSV) {
+                filaTSV(s, nodo, hijos, ahora);
+            } else {
+                if (nivel != nivelActual) {  // Comprueba si se ha cambiado a una nueva generación
+                    nivelActual = nivel;
+                    s.texto("\n--- GENERACION "); s.entero(nivel); s.texto(" ---\n");
+                }
+                s.texto("Nombre: "); s.nombre(nodo, formato);
+                s.texto(" | Tipo: "); s.texto(nodo->tipoTexto());
+                s.texto(" | Genero: "); s.texto(nodo->generoTexto());
+                s.texto(" | Estado: "); s.texto(nodo->estadoTexto());
+                s.texto(" | Padre: ");
+                if (nodo->padre) s.nombre(nodo->padre, formato); else s.texto("Ninguno"); // Nombre del padre o "Ninguno"
+                s.texto(" | Hijos: "); s.entero(hijos);
+                s.texto(" | Edad: "); s.entero(ahora - nodo->nacimiento);
+                s.caracter('\n');
+            }
+            if (izquierda) q.push_back(izquierda); // Hijos al final de la cola
+            if (derecha)   q.push_back(derecha);
+        }
+    }
+
+    // ---------------------------
+    // EXPORTACIÓN (DOT, NDJSON, CSV)
+    // ---------------------------
+    // Escribe el subárbol de 'inicio' en preorden, hasta 'niveles' generaciones debajo de él (-1: todas).
+    // Cada nodo se escribe apenas se visita y el recorrido no usa pila, así que la memoria no depende
+    // del tamaño del árbol. El CSV es el formato que lee importarCsv (padres antes que hijos, izquierdo
+    // antes que derecho); 'inicio' sale sin padre para que el subárbol se pueda importar solo.
+    void exportar(ostream& out, FormatoExportacion formato, Nodo* inicio, int niveles = -1) {
+        GuardiaLectura guardia; // Se puede llamar desde un hilo lector mientras otro escribe
+        Salida s(out);
+        int ahora = yearsElapsed();
+        long long base = (long long)time(NULL) - ahora; // Ver diferenciaReloj: nacimiento absoluto con la edad de ahora
+        int nivelMaximo = (niveles < 0 || niveles > INT_MAX - inicio->profundidad) ? INT_MAX : inicio->profundidad + niveles;
+        if (formato == EXPORTAR_DOT) {
+            s.texto("digraph arbol {\n"
+                    "  // Color por tipo (Agua azul, Fuego rojo, Roca gris); borde punteado: Muerto\n"
+                    "  node [shape=box, style=filled, fontname=\"Helvetica\"];\n");
+        } else if (formato == EXPORTAR_CSV) {
+            s.texto("nombre,tipo,genero,estado,padre,nacimiento\n");
+        }
+        static const char* const COLOR_DOT[] = { "\"#9ecae1\"", "\"#fc9272\"", "\"#bdbdbd\"" }; // Por Tipo
+        recorrer(inicio, PREORDEN, [&](Nodo* n) {
+            Nodo* padre = (n == inicio) ? NULL : (Nodo*)n->padre;
+            if (formato == EXPORTAR_DOT) {
+                s.texto("  "); s.entreComillas(n->nombre, n->largo);
+                s.texto(" [fillcolor="); s.texto(COLOR_DOT[n->tipo]);
+                if (n->estado == ESTADO_MUERTO) s.texto(", style=\"filled,dashed\"");
+                s.texto("];\n");
+                if (padre) {
+                    s.texto("  "); s.entreComillas(padre->nombre, padre->largo);
+                    s.texto(" -> "); s.entreComillas(n->nombre, n->largo); s.texto(";\n");
+                }
+            } else if (formato == EXPORTAR_NDJSON) {
+                s.texto("{\"nombre\":"); s.entreComillas(n->nombre, n->largo);
+                s.texto(",\"tipo\":\""); s.texto(n->tipoTexto());
+                s.texto("\",\"genero\":\""); s.texto(n->generoTexto());
+                s.texto("\",\"estado\":\""); s.texto(n->estadoTexto());
+                s.texto("\",\"padre\":");
+                if (padre) s.entreComillas(padre->nombre, padre->largo); else s.texto("null");
+                s.texto(",\"generacion\":"); s.entero(n->profundidad);
+                s.texto(",\"hijos\":"); s.entero(n->hijos());
+                s.texto(",\"nacimiento\":"); s.entero(base + n->nacimiento);
+                s.texto(",\"edad\":"); s.entero(ahora - n->nacimiento);
+                s.texto("}\n");
+            } else {
+                s.texto(n->nombre, n->largo); s.caracter(',');
+                s.texto(n->tipoTexto()); s.caracter(',');
+                s.texto(n->generoTexto()); s.caracter(',');
+                s.texto(n->estadoTexto()); s.caracter(',');
+                if (padre) s.texto(padre->nombre, padre->largo);
+                s.caracter(',');
+                s.entero(base + n->nacimiento); s.caracter('\n');
+            }
+        }, nivelMaximo);
+        if (formato == EXPORTAR_DOT) s.texto("}\n");
+    }
+
+    // Exporta a un archivo; devuelve false (con el motivo en 'error') si no se pudo escribir
+    bool exportarArchivo(const string& ruta, FormatoExportacion formato, Nodo* inicio, int niveles, string& error) {
+        ofstream archivo(ruta.c_str(), ios::binary);
+        if (!archivo) { error = "No se pudo crear " + ruta; return false; }
+        exportar(archivo, formato, inicio, niveles);
+        archivo.close();
+        if (archivo.fail()) { error = "No se pudo escribir " + ruta; return false; }
+        return true;
+    }
+
+    // Pide formato, archivo, personaje de inicio y generaciones, y exporta
+    void exportarInteractivo() {
+        int op;
+        cout << "\nFormato:\n1. DOT (Graphviz)\n2. NDJSON\n3. CSV (se puede volver a importar)\nOpcion: ";
+        cin >> op;
+        while (op < 1 || op > 3) {
+            cout << "Opcion invalida. Intente de nuevo: ";
+            cin >> op;
+        }
+        string ruta, nombre, error;
+        int niveles;
+        cout << "Archivo: ";
+        cin >> ruta;
+        cout << "Desde que personaje (- para todo el arbol): ";
+        cin >> nombre;
+        Nodo* inicio = nombre == "-" ? (Nodo*)raiz : buscar(nombre);
+        if (!inicio) { cout << "No existe ese personaje.\n"; return; }
+        cout << "Cuantas generaciones hacia abajo (-1 para todas): ";
+        cin >> niveles;
+        if (!exportarArchivo(ruta, (FormatoExportacion)(op - 1), inicio, niveles, error)) { cout << "ERROR: " << error << "\n"; return; }
+        cout << "Exportado a " << ruta << ".\n";
+    }
+
+    // Funciones de recorrido clásico del árbol (iterativas, con el motor 'recorrer' y salida con búfer)
+    void recorridoPreorden(Nodo* nodo, ostream& out = cout) {  // Recorrido: Nodo - Izquierda - Derecha
+        GuardiaLectura guardia;
+        Salida s(out);
+        recorrer(nodo, PREORDEN, [&](Nodo* n) { s.texto(n->nombre, n->largo); s.caracter(' '); }); // Visita cada nodo imprimiendo su nombre
+    }
+
+    void recorridoInorden(Nodo* nodo, ostream& out = cout) {   // Recorrido: Izquierda - Nodo - Derecha
+        GuardiaLectura guardia;
+        Salida s(out);
+        recorrer(nodo, INORDEN, [&](Nodo* n) { s.texto(n->nombre, n->largo); s.caracter(' '); });
+    }
+
+    void recorridoPostorden(Nodo* nodo, ostream& out = cout) { // Recorrido: Izquierda - Derecha - Nodo
+        GuardiaLectura guardia;
+        Salida s(out);
+        recorrer(nodo, POSTORDEN, [&](Nodo* n) { s.texto(n->nombre, n->largo); s.caracter(' '); });
+    }
+
+    void preorden(ostream& out = cout)  { MedirOperacion m(OP_PREORDEN); recorridoPreorden(raiz, out); out << "\n"; } // Función de envoltura: inicia el preorden desde la raíz
+    void inorden(ostream& out = cout)   { MedirOperacion m(OP_INORDEN); recorridoInorden(raiz, out);  out << "\n"; } // Función de envoltura: inicia el inorden desde la raíz
+    void postorden(ostream& out = cout) { MedirOperacion m(OP_POSTORDEN); recorridoPostorden(raiz, out); out << "\n"; } // Función de envoltura: inicia el postorden desde la raíz
+
+    // ---------------------------
+    // ÁRBOL VERTICAL CENTRADO
+    // ---------------------------
+    // Dibujo ordenado al estilo Reingold–Tilford en O(n):
+    //  1. En postorden se calcula, para cada subárbol, su contorno izquierdo y derecho (borde
+    //     más extremo en cada nivel). Los dos hijos se separan lo justo para que sus contornos
+    //     no se toquen; solo se comparan los niveles del subárbol más bajo, y el contorno del
+    //     más profundo se reutiliza, así que el trabajo total es lineal.
+    //  2. En preorden las posiciones relativas se vuelven columnas absolutas.
+    //  3. Se escribe por generaciones, de izquierda a derecha, sin lienzo de ancho fijo.
+    // El ancho de cada etiqueta se mide una sola vez y sin contar los códigos ANSI.
+    static const int SEPARACION = 2; // Espacios mínimos entre dos etiquetas del mismo nivel
+
+    // Contorno de un subárbol guardado de abajo hacia arriba (la raíz al final), con un
+    // desplazamiento común 'base' para poder mover todo el subárbol en O(1).
+    struct Contorno {
+        vector<int> izq, der; // Borde izquierdo / derecho (columnas inclusivas) de cada nivel
+        int baseIzq, baseDer;
+        int nivelIzq(size_t k) const { return izq[izq.size() - 1 - k] + baseIzq; } // k = 0 es la fila de la raíz
+        int nivelDer(size_t k) const { return der[der.size() - 1 - k] + baseDer; }
+    };
+
+    // Ancho visible de una etiqueta: cuenta caracteres UTF-8, no bytes
+    static int anchoVisible(const char* texto, unsigned int largo) {
+        int ancho = 0;
+        for (unsigned int i = 0; i < largo; i++)
+            if (((unsigned char)texto[i] & 0xC0) != 0x80) ancho++;
+        return ancho;
+    }
+
+    // Copia de la forma del árbol para el dibujo: cada enlace se lee una sola vez, así los tres
+    // pasos ven el mismo árbol aunque el escritor inserte o elimine mientras tanto
+    struct NodoDibujo {
+        Nodo* n;
+        int padre, izq, der; // Posiciones dentro de la copia (-1: no hay)
+        int nivel;
+    };
+
+    // Función para mostrar el árbol como un diagrama vertical centrado (coloreado en FORMATO_ANSI)
+    void mostrarArbolVertical(ostream& out = cout, FormatoSalida formato = FORMATO_ANSI) {
+        MedirOperacion medir(OP_ARBOL_VERTICAL);
+        GuardiaLectura guardia; // Ningún nodo de la copia se libera mientras se dibuja
+        Salida s(out);
+        s.texto("\n=== ARBOL VERTICAL CENTRADO Y COLOREADO ===\n\n");
+
+        // Paso 0: copia en orden BFS (cada hijo queda después de su padre)
+        vector<NodoDibujo> d;
+        NodoDibujo r = { raiz, -1, -1, -1, 0 };
+        d.push_back(r);
+        for (size_t i = 0; i < d.size(); i++) {
+            Nodo* hijos[2] = { d[i].n->izquierda, d[i].n->derecha };
+            for (int h = 0; h < 2; h++) {
+                if (!hijos[h]) continue;
+                NodoDibujo c = { hijos[h], (int)i, -1, -1, d[i].nivel + 1 };
+                (h == 0 ? d[i].izq : d[i].der) = (int)d.size();
+                d.push_back(c);
+            }
+        }
+
+        vector<int> ancho(d.size());            // Ancho visible de la etiqueta (medido una vez)
+        vector<int> rel(d.size(), 0);           // Centro del nodo relativo al centro de su padre
+        vector<int> contornoDe(d.size(), -1);   // Contorno en uso por el subárbol de cada nodo
+        vector<Contorno> contornos;             // Contornos vivos (a lo sumo uno por hoja)
+        vector<int> contornosLibres;            // Contornos devueltos para reutilizar
+
+        // Paso 1: BFS al revés, los hijos quedan listos antes que el padre
+        for (size_t i = d.size(); i-- > 0; ) {
+            int w = ancho[i] = anchoVisible(d[i].n->nombre, d[i].n->largo);
+            int a = w / 2, b = w - 1 - w / 2; // Distancia del centro al borde izquierdo / derecho
+            int L = d[i].izq;
+            int R = d[i].der;
+            int c;
+            if (L >= 0 && R >= 0) {
+                Contorno& cl = contornos[contornoDe[L]];
+                Contorno& cr = contornos[contornoDe[R]];
+                size_t comunes = min(cl.der.size(), cr.izq.size());
+                int dist = a + b + 4; // Distancia mínima entre los centros de los hijos (deja sitio a '/' y '\')
+                for (size_t k = 0; k < comunes; k++)
+                    dist = max(dist, cl.nivelDer(k) - cr.nivelIzq(k) + 1 + SEPARACION);
+                int extra = dist - (a + b + 4);
+                rel[L] = -(a + 2) - extra / 2;
+                rel[R] = (b + 2) + (extra - extra / 2);
+                int rl = rel[L], rr = rel[R];
+                bool izquierdoMasProfundo = cl.izq.size() >= cr.izq.size();
+                c = izquierdoMasProfundo ? contornoDe[L] : contornoDe[R];
+                int otro = izquierdoMasProfundo ? contornoDe[R] : contornoDe[L];
+                Contorno& m = contornos[c];
+                Contorno& o = contornos[otro];
+                int rm = izquierdoMasProfundo ? rl : rr, ro = izquierdoMasProfundo ? rr : rl;
+                m.baseIzq += rm; m.baseDer += rm;
+                size_t h = o.izq.size(), hm = m.izq.size();
+                for (size_t k = 0; k < h; k++) { // Los niveles superiores del lado del menos profundo vienen de él
+                    if (izquierdoMasProfundo) m.der[hm - 1 - k] = o.nivelDer(k) + ro - m.baseDer;
+                    else                      m.izq[hm - 1 - k] = o.nivelIzq(k) + ro - m.baseIzq;
+                }
+                contornosLibres.push_back(otro);
+            } else if (L >= 0 || R >= 0) {
+                int h = L >= 0 ? L : R;
+                rel[h] = L >= 0 ? -(a + 2) : (b + 2); // Hijo único: su rama nace junto al borde de la etiqueta
+                c = contornoDe[h];
+                contornos[c].baseIzq += rel[h];
+                contornos[c].baseDer += rel[h];
+            } else {
+                if (contornosLibres.empty()) { contornos.push_back(Contorno()); c = (int)contornos.size() - 1; }
+                else { c = contornosLibres.back(); contornosLibres.pop_back(); }
+                contornos[c].izq.clear(); contornos[c].der.clear();
+                contornos[c].baseIzq = contornos[c].baseDer = 0;
+            }
+            // Fila propia: la etiqueta más los guiones bajos que llegan hasta las ramas
+            Contorno& m = contornos[c];
+            m.izq.push_back(min(-a, L >= 0 ? rel[L] + 2 : -a) - m.baseIzq);
+            m.der.push_back(max(b, R >= 0 ? rel[R] - 2 : b) - m.baseDer);
+            contornoDe[i] = c;
+        }
+
+        // Paso 2: columnas absolutas; la columna 0 es el borde más a la izquierda del dibujo
+        Contorno& total = contornos[contornoDe[0]];
+        int minimo = 0;
+        for (size_t k = 0; k < total.izq.size(); k++) minimo = min(minimo, total.nivelIzq(k));
+        vector<int>& x = rel; // Se reutiliza: ahora guarda el centro absoluto (el padre va antes que sus hijos)
+        for (size_t i = 0; i < d.size(); i++) x[i] = d[i].padre >= 0 ? x[d[i].padre] + rel[i] : -minimo;
+
+        // Paso 3: cada generación ocupa una fila de etiquetas y una de ramas (en BFS ya van seguidas)
+        size_t inicio = 0;
+        while (inicio < d.size()) {
+            size_t fin = inicio;
+            while (fin < d.size() && d[fin].nivel == d[inicio].nivel) fin++;
+            int col = 0; // Columna donde está el cursor en la fila actual
+            bool hayRamas = false;
+            for (size_t i = inicio; i < fin; i++) {
+                int c = x[i], w = ancho[i];
+                int desde = c - w / 2;
+                if (d[i].izq >= 0) {
+                    int g = x[d[i].izq] + 2;
+                    for (; col < g; col++) s.caracter(' ');
+                    for (; col < desde; col++) s.caracter('_');
+                }
+                for (; col < desde; col++) s.caracter(' ');
+                s.nombre(d[i].n, formato);
+                col += w;
+                if (d[i].der >= 0) {
+                    int g = x[d[i].der] - 1;
+                    for (; col < g; col++) s.caracter('_');
+                }
+                hayRamas = hayRamas || d[i].izq >= 0 || d[i].der >= 0;
+            }
+            s.caracter('\n');
+            if (hayRamas) { // Fila de ramas
+                col = 0;
+                for (size_t i = inicio; i < fin; i++) {
+                    if (d[i].izq >= 0) {
+                        for (int g = x[d[i].izq] + 1; col < g; col++) s.caracter(' ');
+                        s.caracter('/'); col++;
+                    }
+                    if (d[i].der >= 0) {
+                        for (int g = x[d[i].der] - 1; col < g; col++) s.caracter(' ');
+                        s.caracter('\\'); col++;
+                    }
+                }
+                s.caracter('\n');
+            }
+            inicio = fin;
+        }
+        s.caracter('\n');
+    }
+
+    // ---------------------------
+    // INSTANTÁNEAS BINARIAS
+    // ---------------------------
+    // Guarda todo el árbol en 'ruta'. Escribe primero un archivo temporal y luego lo renombra,
+    // así una caída a mitad de la escritura no daña la instantánea anterior.
+    bool guardarInstantanea(const char* ruta, string& error) {
+        vector<uint32_t> posicion(pool.usadas, SIN_NODO); // Posición en la tabla de cada nodo (por su id)
+        vector<Nodo*> enOrden;                              // Nodos en orden BFS
+        enOrden.reserve(pool.vivos);
+        enOrden.push_back(raiz);
+        posicion[raiz->id] = 0;
+        for (size_t i = 0; i < enOrden.size(); i++) { // El propio vector sirve de cola del BFS
+            Nodo* act = enOrden[i];
+            if (act->izquierda) { posicion[act->izquierda->id] = (uint32_t)enOrden.size(); enOrden.push_back(act->izquierda); }
+            if (act->derecha)   { posicion[act->derecha->id]   = (uint32_t)enOrden.size(); enOrden.push_back(act->derecha); }
+        }
+
+        vector<RegistroNodo> tabla(enOrden.size());
+        string zonaNombres;
+        int64_t guardado = (int64_t)time(NULL);
+        int64_t base = diferenciaReloj(guardado);
+        for (size_t i = 0; i < enOrden.size(); i++) {
+            Nodo* n = enOrden[i];
+            RegistroNodo& r = tabla[i];
+            memset(&r, 0, sizeof(r));
+            r.nombre = (uint32_t)zonaNombres.size();
+            r.largo = n->largo;
+            zonaNombres.append(n->nombre, n->largo);
+            zonaNombres.push_back('\0');
+            r.padre = n->padre ? posicion[n->padre->id] : SIN_NODO;
+            r.izquierda = n->izquierda ? posicion[n->izquierda->id] : SIN_NODO;
+            r.derecha = n->derecha ? posicion[n->derecha->id] : SIN_NODO;
+            r.tipo = n->tipo;
+            r.genero = n->genero;
+            r.estado = n->estado;
+            r.nacimiento = base + n->nacimiento;
+        }
+        if (zonaNombres.size() > 0xFFFFFFFFu) { error = "Los nombres no caben en una instantanea."; return false; }
+
+        CabeceraInstantanea cab;
+        memset(&cab, 0, sizeof(cab));
+        memcpy(cab.magia, MAGIA_INSTANTANEA, sizeof(cab.magia));
+        cab.version = VERSION_INSTANTANEA;
+        cab.cantidad = (uint32_t)tabla.size();
+        cab.largoNombres = zonaNombres.size();
+        cab.guardado = guardado;
+
+        string temporal = string(ruta) + ".tmp";
+        FILE* f = fopen(temporal.c_str(), "wb");
+        if (!f) { error = "No se pudo crear " + temporal; return false; }
+        bool ok = fwrite(&cab, sizeof(cab), 1, f) == 1
+               && fwrite(&tabla[0], sizeof(RegistroNodo), tabla.size(), f) == tabla.size()
+               && fwrite(zonaNombres.data(), 1, zonaNombres.size(), f) == zonaNombres.size()
+               && fflush(f) == 0;
+#ifdef _WIN32
+        ok = ok && _commit(_fileno(f)) == 0;  // Fuerza los datos al disco antes de renombrar
+#else
+        ok = ok && fsync(fileno(f)) == 0;     // Fuerza los datos al disco antes de renombrar
+#endif
+        ok = (fclose(f) == 0) && ok;
+#ifdef _WIN32
+        remove(ruta); // En Windows rename no reemplaza un archivo existente
+#endif
+        if (!ok || rename(temporal.c_str(), ruta) != 0) {
+            remove(temporal.c_str());
+            error = string("No se pudo escribir ") + ruta;
+            return false;
+        }
+        return true;
+    }
+
+    // Revisa que el contenido mapeado sea una instantánea válida: tamaños, nombres terminados en '\0'
+    // y sin repetir, y tabla en orden BFS exacto (cada nodo aparece una sola vez como hijo y después
+    // de su padre). Todo se revisa antes de tocar el árbol: si falla, el árbol queda como estaba.
+    static bool validarInstantanea(const char* datos, size_t tam, string& error) {
+        if (tam < LARGO_CABECERA_V1) { error = "Archivo demasiado corto."; return false; }
+        CabeceraInstantanea cab;
+        cab.leer(datos, tam);
+        if (memcmp(cab.magia, MAGIA_INSTANTANEA, sizeof(cab.magia)) != 0) { error = "No es una instantanea."; return false; }
+        if (cab.version != 1 && cab.version != VERSION_INSTANTANEA) { error = "Version de instantanea no soportada."; return false; }
+        if (cab.cantidad == 0 || cab.cantidad == SIN_NODO) { error = "Cantidad de nodos invalida."; return false; }
+        uint64_t esperado = cab.largo() + (uint64_t)cab.cantidad * sizeof(RegistroNodo) + cab.largoNombres;
+        if (esperado != tam) { error = "El tamano del archivo no coincide con su cabecera."; return false; }
+
+        const RegistroNodo* tabla = (const RegistroNodo*)(datos + cab.largo());
+        const char* zona = datos + cab.largo() + (size_t)cab.cantidad * sizeof(RegistroNodo);
+        uint32_t siguienteHijo = 1; // En orden BFS los hijos aparecen exactamente en este orden
+        for (uint32_t i = 0; i < cab.cantidad; i++) {
+            const RegistroNodo& r = tabla[i];
+            if ((uint64_t)r.nombre + r.largo >= cab.largoNombres || zona[r.nombre + r.largo] != '\0' || r.largo == 0) {
+                error = "Nombre invalido en el nodo " + to_string(i) + "."; return false;
+            }
+            if (r.tipo > TIPO_ROCA || r.genero > GENERO_NINGUNO || r.estado > ESTADO_MUERTO) {
+                error = "Atributos invalidos en el nodo " + to_string(i) + "."; return false;
+            }
+            if ((i == 0) != (r.padre == SIN_NODO)) { error = "Solo la raiz puede no tener padre."; return false; }
+            uint32_t hijos[2] = { r.izquierda, r.derecha };
+            for (int h = 0; h < 2; h++) {
+                if (hijos[h] == SIN_NODO) continue;
+                if (hijos[h] >= cab.cantidad || hijos[h] != siguienteHijo || tabla[hijos[h]].padre != i) { // Sin leer fuera de la tabla
+                    error = "Enlaces invalidos en el nodo " + to_string(i) + "."; return false;
+                }
+                siguienteHijo++;
+            }
+        }
+        if (siguienteHijo != cab.cantidad) { error = "Hay nodos que no cuelgan del arbol."; return false; }
+
+        // Nombres repetidos: tabla hash de posiciones en la tabla de nodos, con sondeo lineal
+        size_t capacidad = 16;
+        while (capacidad < 2 * (size_t)cab.cantidad) capacidad *= 2; // Carga de 50% como máximo
+        vector<uint32_t> casillas(capacidad, SIN_NODO);
+        for (uint32_t i = 0; i < cab.cantidad; i++) {
+            const char* nombre = zona + tabla[i].nombre;
+            uint32_t largo = tabla[i].largo;
+            for (size_t c = hashNombre(nombre, largo) & (capacidad - 1); ; c = (c + 1) & (capacidad - 1)) {
+                if (casillas[c] == SIN_NODO) { casillas[c] = i; break; }
+                const RegistroNodo& otro = tabla[casillas[c]];
+                if (otro.largo == largo && memcmp(zona + otro.nombre, nombre, largo) == 0) {
+                    error = "Nombre repetido en la instantanea: " + string(nombre, largo) + "."; return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // ---------------------------
+    // RECUPERACIÓN DESDE LA BITÁCORA
+    // ---------------------------
+    // Vuelve a aplicar, en orden, los registros de la bitácora 'ruta' sobre el árbol actual
+    // (normalmente recién cargado de la última instantánea). Se detiene en el primer registro
+    // incompleto o dañado, que corresponde a una escritura cortada por una caída.
+    bool reproducirBitacora(const char* ruta, long& aplicadas, string& error) {
+        aplicadas = 0;
+        ArchivoMapeado mapa;
+        if (!mapa.abrir(ruta)) return true; // No hay bitácora: no hay nada que recuperar
+        const char* p = mapa.datos;
+        const char* fin = mapa.datos + mapa.tam;
+        while (fin - p >= 8) {
+            uint32_t largo, suma;
+            memcpy(&largo, p, 4);
+            memcpy(&suma, p + 4, 4);
+            if ((size_t)(fin - p - 8) < largo || hashNombre(p + 8, largo) != suma) break; // Registro cortado
+            const char* c = p + 8;
+            const char* finRegistro = c + largo;
+            p = finRegistro;
+            const char* nombre;
+            uint32_t largoNombre;
+            if (largo >= 12 && c[0] == BITACORA_INSERTAR) {
+                uint8_t tipo = (uint8_t)c[1], genero = (uint8_t)c[2], estado = (uint8_t)c[3];
+                int64_t nacimiento;
+                memcpy(&nacimiento, c + 4, 8);
+                c += 12;
+                const char* nombrePadre;
+                uint32_t largoPadre;
+                if (!Bitacora::leerTexto(c, finRegistro, nombre, largoNombre) || !Bitacora::leerTexto(c, finRegistro, nombrePadre, largoPadre)
+                    || tipo > TIPO_ROCA || genero > GENERO_NINGUNO || estado > ESTADO_MUERTO) {
+                    error = "Registro de insercion invalido."; return false;
+                }
+                int lado = c < finRegistro ? (uint8_t)*c : -1; // Las bitácoras viejas no guardan el lado
+                int64_t base = (int64_t)start_time;             // ni la hora del registro
+                if (finRegistro - c >= 9) {
+                    int64_t guardado;
+                    memcpy(&guardado, c + 1, 8);
+                    base = diferenciaReloj(guardado);
+                }
+                Nodo* padre = buscar(nombrePadre, largoPadre);
+                if (!padre || padre->hijos() >= MAX_HIJOS || buscar(nombre, largoNombre) || lado > 1
+                    || (lado >= 0 && (lado == 0 ? padre->izquierda : padre->derecha) != NULL)) {
+                    error = "La bitacora no corresponde a la instantanea (" + string(nombre, largoNombre) + ")."; return false;
+                }
+                enlazarNuevo(nombre, largoNombre, (Tipo)tipo, (Genero)genero, (Estado)estado, padre, lado,
+                             (int)(nacimiento - base));
+            } else if (largo >= 1 && c[0] == BITACORA_ELIMINAR) {
+                c += 1;
+                if (!Bitacora::leerTexto(c, finRegistro, nombre, largoNombre)) { error = "Registro de eliminacion invalido."; return false; }
+                Nodo* n = buscar(nombre, largoNombre);
+                if (!n || n == raiz || n->hijos() > 0) {
+                    error = "La bitacora no corresponde a la instantanea (" + string(nombre, largoNombre) + ")."; return false;
+                }
+                quitarHoja(n);
+            } else if (largo >= 2 && c[0] == BITACORA_ESTADO) {
+                uint8_t estado = (uint8_t)c[1];
+                c += 2;
+                if (!Bitacora::leerTexto(c, finRegistro, nombre, largoNombre) || estado > ESTADO_MUERTO) {
+                    error = "Registro de cambio de estado invalido."; return false;
+                }
+                Nodo* n = buscar(nombre, largoNombre);
+                if (!n) { error = "La bitacora no corresponde a la instantanea (" + string(nombre, largoNombre) + ")."; return false; }
+                aplicarEstado(n, (Estado)estado);
+            } else {
+                error = "Registro de bitacora desconocido."; return false;
+            }
+            aplicadas++;
+        }
+        return true;
+    }
+
+    // Reemplaza el árbol por la instantánea de 'ruta'. El archivo se mapea en memoria y los nombres
+    // se usan directamente desde el mapeo; los nodos se arman en una sola pasada por la tabla.
+    bool cargarInstantanea(const char* ruta, string& error) {
+        ArchivoMapeado mapa;
+        if (!mapa.abrir(ruta)) { error = string("No se pudo abrir ") + ruta; return false; }
+        if (!validarInstantanea(mapa.datos, mapa.tam, error)) return false;
+
+        CabeceraInstantanea cab;
+        cab.leer(mapa.datos, mapa.tam);
+        const RegistroNodo* tabla = (const RegistroNodo*)(mapa.datos + cab.largo());
+        const char* zona = mapa.datos + cab.largo() + (size_t)cab.cantidad * sizeof(RegistroNodo);
+        int64_t base = cab.version == 1 ? (int64_t)start_time : diferenciaReloj(cab.guardado);
+
+        vaciar();
+        instantanea.adoptar(mapa); // El árbol se queda con el mapeo mientras existan sus nodos
+        construirDesdeTabla(tabla, cab.cantidad, [&](uint32_t i) { return zona + tabla[i].nombre; }, base);
+        return true;
+    }
+
+    // Reemplaza el árbol por los personajes de un archivo CSV/TSV (ver ImportacionCsv). Si el
+    // archivo tiene errores el árbol queda como estaba.
+    bool importarCsv(const char* ruta, string& error) {
+        ImportacionCsv importacion;
+        if (!importacion.leer(ruta, error)) return false;
+        vaciar();
+        construirDesdeTabla(&importacion.tabla[0], (uint32_t)importacion.tabla.size(), [&](uint32_t i) {
+            const ImportacionCsv::Fila& f = importacion.filas[importacion.ordenBfs[i]];
+            return nombres.guardar(f.nombre, f.largo); // El archivo se cierra al terminar: los nombres se copian
+        }, diferenciaReloj(importacion.momento)); // Los momentos del CSV se cuentan hasta la hora de leerlo
+        return true;
+    }
+
+    // Arma el árbol (vacío) con una tabla de nodos en orden BFS, como la de las instantáneas.
+    // nombreDe(i) da el nombre del nodo i, que tiene que durar tanto como el nodo, y 'base' es la
+    // diferenciaReloj con la que se restan los nacimientos. La tabla ya viene revisada (enlaces y
+    // nombres sin repetir): armarla no puede fallar a mitad de camino.
+    template <class NombreDe>
+    void construirDesdeTabla(const RegistroNodo* tabla, uint32_t cantidad, NombreDe nombreDe, int64_t base) {
+        // Con el pool vacío, el nodo de la posición i recibe el id i: los enlaces se resuelven directo
+        const unsigned long long PASO = 1ULL << 32; // Separación de las etiquetas dentro de cada generación
+        unsigned long long etiqueta = 0;
+        for (uint32_t i = 0; i < cantidad; i++) {
+            const RegistroNodo& r = tabla[i];
+            Nodo* padre = (r.padre == SIN_NODO) ? NULL : pool.nodo(r.padre);
+            Nodo* n = pool.crear(nombreDe(i), r.largo, (Tipo)r.tipo, (Genero)r.genero, (Estado)r.estado, padre);
+            n->nacimiento = (int)(r.nacimiento - base);
+            if (i == 0) raiz = n;
+            else {
+                if (n->profundidad != pool.nodo(i - 1)->profundidad) etiqueta = 0; // Empieza una nueva generación
+                if (tabla[r.padre].izquierda == i) padre->izquierda = n;
+                else padre->derecha = n;
+            }
+            etiqueta += PASO;
+            n->orden = (i == 0) ? 1ULL << 63 : etiqueta;
+            indice.insertar(n);
+            ordenNombres.insertar(n);
+            atributos.agregar(n);
+        }
+        // Los nodos ya están en orden BFS: se agregan al final de los conjuntos sin buscar posición.
+        // Las hojas van por nacimiento, que en una instantánea o un CSV no tiene por qué seguir el
+        // orden BFS: se ordenan primero y se insertan de una vez.
+        vector<Nodo*> nuevasHojas;
+        for (uint32_t i = 0; i < cantidad; i++) {
+            Nodo* n = pool.nodo(i);
+            if (n->hijos() > 0) conHijos.insert(conHijos.end(), n);
+            if (n->hijos() < MAX_HIJOS) libres.insert(libres.end(), n);
+            if (n->hijos() == 0) nuevasHojas.push_back(n);
+        }
+        sort(nuevasHojas.begin(), nuevasHojas.end(), PorNacimiento());
+        hojas.insert(nuevasHojas.begin(), nuevasHojas.end());
+        agregadosSucios = true; // Los contadores se calculan de una vez en la primera consulta
+        if (historial) historial->comenzar(raiz);
+    }
+
+};
+
+// --------------------------------------
+// VOLCADO DE MÉTRICAS
+// --------------------------------------
+// Tres formatos: una tabla para la consola, texto de Prometheus (para un "textfile collector")
+// y líneas JSON como las de los benchmarks.
+enum FormatoMetricas { METRICAS_TABLA, METRICAS_PROMETHEUS, METRICAS_JSON };
+const string TEXTO_FORMATO_METRICAS[] = { "TABLA", "PROM", "JSON" };
+
+// Con extensión .json el archivo va en JSON; si no, en texto de Prometheus
+FormatoMetricas formatoMetricasDeRuta(const string& ruta) {
+    return ruta.size() >= 5 && ruta.compare(ruta.size() - 5, 5, ".json") == 0 ? METRICAS_JSON : METRICAS_PROMETHEUS;
+}
+
+// Duración legible con la unidad que corresponda (ns, us, ms, s)
+string textoDuracion(double ns) {
+    char texto[32];
+    if (ns < 1000) snprintf(texto, sizeof(texto), "%.0fns", ns);
+    else if (ns < 1e6) snprintf(texto, sizeof(texto), "%.1fus", ns / 1e3);
+    else if (ns < 1e9) snprintf(texto, sizeof(texto), "%.1fms", ns / 1e6);
+    else snprintf(texto, sizeof(texto), "%.2fs", ns / 1e9);
+    return texto;
+}
+
+void escribirMetricas(ostream& out, Arbol& arbol, FormatoMetricas formato) {
+    vector<Histograma> total(CANTIDAD_OPERACIONES);
+    registroMetricas.juntar(&total[0]);
+    unsigned long long nodos = arbol.indice.vivos;
+    int altura = arbol.agregadoDe(arbol.raiz).altura;
+    unsigned long long bytesNodos = (unsigned long long)arbol.pool.bloques.size() * PoolNodos::NODOS_POR_BLOQUE * sizeof(Nodo);
+    unsigned long long bytesPedidos = totalBytesPedidos.load(memory_order_relaxed);
+    unsigned long long asignaciones = totalAsignaciones.load(memory_order_relaxed);
+    char linea[512];
+
+    if (formato == METRICAS_TABLA) {
+        out << "\n=== METRICAS ===\n";
+        snprintf(linea, sizeof(linea), "%-22s %12s %10s %10s %10s %10s %10s\n", "operacion", "llamadas", "media", "p50", "p90", "p99", "max");
+        out << linea;
+        for (int op = 0; op < CANTIDAD_OPERACIONES; op++) {
+            const Histograma& h = total[op];
+            unsigned long long llamadas = h.llamadas.load(), muestras = h.muestras();
+            if (llamadas == 0) continue;
+            snprintf(linea, sizeof(linea), "%-22s %12llu %10s %10s %10s %10s %10s\n", TEXTO_OPERACION[op], llamadas,
+                     textoDuracion(muestras ? (double)h.sumaNs.load() / muestras : 0).c_str(), textoDuracion((double)h.percentil(0.5)).c_str(),
+                     textoDuracion((double)h.percentil(0.9)).c_str(), textoDuracion((double)h.percentil(0.99)).c_str(),
+                     textoDuracion((double)h.maximoNs.load()).c_str());
+            out << linea;
+        }
+        snprintf(linea, sizeof(linea), "Nodos: %llu | Altura: %d | Memoria de nodos: %llu KB | Pico: %ld KB",
+                 nodos, altura, bytesNodos / 1024, memoriaPicoKb());
+        out << linea;
+        if (CONTANDO_ASIGNACIONES) {
+            snprintf(linea, sizeof(linea), " | Pedido en total: %llu KB en %llu asignaciones", bytesPedidos / 1024, asignaciones);
+            out << linea;
+        }
+        out << "\n";
+        return;
+    }
+
+    if (formato == METRICAS_JSON) {
+        for (int op = 0; op < CANTIDAD_OPERACIONES; op++) {
+            const Histograma& h = total[op];
+            unsigned long long muestras = h.muestras();
+            snprintf(linea, sizeof(linea), "{\"operacion\":\"%s\",\"llamadas\":%llu,\"muestras\":%llu,\"media_ns\":%.1f,\"p50_ns\":%llu,\"p90_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu,\"max_ns\":%llu}",
+                     TEXTO_OPERACION[op], h.llamadas.load(), muestras, muestras ? (double)h.sumaNs.load() / muestras : 0.0,
+                     h.percentil(0.5), h.percentil(0.9), h.percentil(0.99), h.percentil(0.999), h.maximoNs.load());
+            out << linea << "\n";
+        }
+        snprintf(linea, sizeof(linea), "{\"nodos\":%llu,\"altura\":%d,\"bytes_nodos\":%llu,\"rss_pico_kb\":%ld",
+                 nodos, altura, bytesNodos, memoriaPicoKb());
+        out << linea;
+        if (CONTANDO_ASIGNACIONES) {
+            snprintf(linea, sizeof(linea), ",\"bytes_pedidos\":%llu,\"asignaciones\":%llu", bytesPedidos, asignaciones);
+            out << linea;
+        }
+        out << "}\n";
+        return;
+    }
+
+    // Prometheus: las casillas finas del histograma se resumen en límites fijos (en segundos)
+    static const double LIMITES_NS[] = { 100, 250, 500, 1e3, 2.5e3, 5e3, 1e4, 2.5e4, 5e4, 1e5, 2.5e5, 5e5,
+                                         1e6, 2.5e6, 5e6, 1e7, 2.5e7, 5e7, 1e8, 2.5e8, 5e8, 1e9, 2.5e9, 5e9, 1e10 };
+    out << "# HELP arbol_operaciones_total Llamadas a cada operacion del arbol.\n"
+        << "# TYPE arbol_operaciones_total counter\n";
+    for (int op = 0; op < CANTIDAD_OPERACIONES; op++)
+        out << "arbol_operaciones_total{operacion=\"" << TEXTO_OPERACION[op] << "\"} " << total[op].llamadas.load() << "\n";
+    out << "# HELP arbol_operacion_segundos Latencia de las llamadas medidas (muestreadas).\n"
+        << "# TYPE arbol_operacion_segundos histogram\n";
+    for (int op = 0; op < CANTIDAD_OPERACIONES; op++) {
+        const Histograma& h = total[op];
+        for (size_t i = 0; i < sizeof(LIMITES_NS) / sizeof(LIMITES_NS[0]); i++) {
+            snprintf(linea, sizeof(linea), "arbol_operacion_segundos_bucket{operacion=\"%s\",le=\"%g\"} %llu\n",
+                     TEXTO_OPERACION[op], LIMITES_NS[i] / 1e9, h.hasta((unsigned long long)LIMITES_NS[i]));
+            out << linea;
+        }
+        snprintf(linea, sizeof(linea), "arbol_operacion_segundos_bucket{operacion=\"%s\",le=\"+Inf\"} %llu\n"
+                 "arbol_operacion_segundos_sum{operacion=\"%s\"} %.9f\n"
+                 "arbol_operacion_segundos_count{operacion=\"%s\"} %llu\n",
+                 TEXTO_OPERACION[op], h.muestras(), TEXTO_OPERACION[op], h.sumaNs.load() / 1e9, TEXTO_OPERACION[op], h.muestras());
+        out << linea;
+    }
+    out << "# TYPE arbol_nodos gauge\narbol_nodos " << nodos << "\n"
+        << "# TYPE arbol_altura gauge\narbol_altura " << altura << "\n"
+        << "# TYPE arbol_bytes_nodos gauge\narbol_bytes_nodos " << bytesNodos << "\n"
+        << "# TYPE arbol_rss_pico_kb gauge\narbol_rss_pico_kb " << memoriaPicoKb() << "\n";
+    if (CONTANDO_ASIGNACIONES)
+        out << "# TYPE arbol_bytes_pedidos_total counter\narbol_bytes_pedidos_total " << bytesPedidos << "\n"
+            << "# TYPE arbol_asignaciones_total counter\narbol_asignaciones_total " << asignaciones << "\n";
+}
+
+// Escribe las métricas en 'ruta' (reemplaza el archivo)
+bool guardarMetricas(const string& ruta, Arbol& arbol, FormatoMetricas formato, string& error) {
+    ofstream archivo(ruta.c_str());
+    if (!archivo) { error = "No se pudo abrir " + ruta; return false; }
+    escribirMetricas(archivo, arbol, formato);
+    if (!archivo.flush()) { error = "No se pudo escribir " + ruta; return false; }
+    return true;
+}
+
+// Opción del menú: muestra la tabla y ofrece guardar un volcado
+void mostrarMetricas(Arbol& arbol) {
+    escribirMetricas(cout, arbol, METRICAS_TABLA);
+    string ruta, error;
+    cout << "Guardar en archivo (.json para JSON, otro nombre para Prometheus, - para no guardar): ";
+    cin >> ruta;
+    if (ruta == "-") return;
+    if (guardarMetricas(ruta, arbol, formatoMetricasDeRuta(ruta), error)) cout << "Metricas guardadas en " << ruta << ".\n";
+    else cout << "ERROR: " << error << "\n";
+}
+
+// --------------------------------------
+// MODO POR LOTES (comandos desde un archivo o una tubería)
+// --------------------------------------
+// Pedazo de texto dentro del búfer del lector (no se copia)
+struct Token {
+    const char* texto; // Inicio de la palabra
+    size_t largo;      // Cantidad de caracteres
+
+    // Indica si el token es exactamente la palabra indicada
+    bool es(const char* palabra) const {
+        return strlen(palabra) == largo && memcmp(palabra, texto, largo) == 0;
+    }
+    string str() const { return string(texto, largo); }
+};
+
+// Lector de comandos con un búfer grande: lee el archivo en pedazos grandes y separa
+// líneas y palabras dentro del mismo búfer, sin copiar cada palabra a un string
+struct LectorComandos {
+    FILE* archivo;     // Archivo de entrada (puede ser stdin)
+    vector<char> buf;  // Búfer de lectura
+    size_t inicio;     // Primer byte pendiente de procesar
+    size_t fin;        // Un byte después del último byte leído
+    bool terminado;    // Ya se llegó al final del archivo
+    long linea;        // Número de la última línea entregada (para los mensajes de error)
+    Bitacora* bitacora; // Si no es NULL, se confirma antes de esperar más datos (no quedan cambios sin fsync)
+
+    explicit LectorComandos(FILE* f) {
+        archivo = f;
+        bitacora = NULL;
+        buf.resize(1 << 20); // 1 MB
+        inicio = 0;
+        fin = 0;
+        terminado = false;
+        linea = 0;
+    }
+
+    // Lee la siguiente línea y la separa en palabras. Los tokens apuntan al búfer y valen
+    // hasta la siguiente llamada. Devuelve false al final del archivo.
+    bool leerLinea(vector<Token>& tokens) {
+        tokens.clear();
+        while (true) {
+            char* desde = &buf[0] + inicio;
+            char* salto = (char*)memchr(desde, '\n', fin - inicio);
+            if (salto || (terminado && inicio < fin)) {
+                char* hasta = salto ? salto : &buf[0] + fin;
+                separar(desde, hasta, tokens);
+                inicio = salto ? (size_t)(salto - &buf[0]) + 1 : fin;
+                linea++;
+                return true;
+            }
+            if (terminado) return false;
+            // No hay línea completa: mueve lo pendiente al principio y lee más
+            memmove(&buf[0], desde, fin - inicio);
+            fin -= inicio;
+            inicio = 0;
+            if (fin == buf.size()) buf.resize(buf.size() * 2); // Línea más larga que el búfer
+            if (bitacora) bitacora->confirmar(); // La lectura puede bloquearse: confirma el grupo pendiente
+#ifdef _WIN32
+            size_t leidos = fread(&buf[0] + fin, 1, buf.size() - fin, archivo);
+#else
+            // read() entrega lo que ya llegó, así que desde una tubería no espera a llenar el búfer
+            ssize_t r = read(fileno(archivo), &buf[0] + fin, buf.size() - fin);
+            size_t leidos = r > 0 ? (size_t)r : 0;
+#endif
+            if (leidos == 0) terminado = true;
+            fin += leidos;
+            reloj.refrescar(); // Llegó un lote nuevo de comandos: el reloj grueso se vuelve a leer
+        }
+    }
+
+    // Separa [desde, hasta) en palabras divididas por espacios, tabuladores o '\r'
+    static void separar(const char* desde, const char* hasta, vector<Token>& tokens) {
+        const char* p = desde;
+        while (p < hasta) {
+            while (p < hasta && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+            const char* palabra = p;
+            while (p < hasta && *p != ' ' && *p != '\t' && *p != '\r') p++;
+            if (p > palabra) {
+                Token t;
+                t.texto = palabra;
+                t.largo = (size_t)(p - palabra);
+                tokens.push_back(t);
+            }
+        }
+    }
+};
+
+// Ejecuta comandos ya separados en tokens sobre un árbol:
+//   INSERT nombre tipo genero estado padre|AUTO (con AUTO el padre lo elige la política de ubicación)
+//   POLICY [nivel|linajes|poblacion] (cambia la política de ubicación; sin argumento la muestra)
+//   DELETE nombre
+//   SAVE archivo   (guarda una instantánea binaria)
+//   LOAD archivo   (reemplaza el árbol por una instantánea)
+//   IMPORT archivo (reemplaza el árbol por las filas de un CSV/TSV: nombre,tipo,genero,estado,padre[,nacimiento])
+//   CLOCK grueso|mono|sim  (modo del reloj de las edades)
+//   ADVANCE segundos       (avanza el reloj simulado)
+//   GEN [PLANO|ANSI|TSV]   (volcado por generaciones)
+//   TREE [PLANO|ANSI]      (diagrama vertical)
+//   GET nombre             (datos de un personaje, una fila TSV)
+//   KIN nombre nombre      (parentesco, grado y ancestro común)
+//   STATS nombre           (tamaño, altura y conteos del subárbol)
+//   ELIGIBLE | CULL        (lista / elimina las hojas con 60 "años" o más)
+//   SET nombre Vivo|Muerto (cambia el estado de un personaje)
+//   COUNT consulta         (cuántos cumplen, por ejemplo: COUNT Agua AND Mujer AND NOT Muerto)
+//   FILTER consulta        (nombres de los que cumplen, en orden de id)
+//   METRICS [TABLA|PROM|JSON] [archivo] (latencias y contadores; con archivo lo reemplaza)
+//   PREFIX texto [max]     (nombres que empiezan con 'texto', en orden alfabético)
+//   RANGE desde hasta [max] (nombres entre 'desde' y 'hasta', ambos incluidos)
+//   FUZZY texto [dist]     (nombres a 'dist' ediciones o menos, por omisión 1, con su distancia)
+//   EXPORT DOT|NDJSON|CSV archivo|- [nombre [niveles]] (subárbol de 'nombre' hasta 'niveles' generaciones; '-': a la salida)
+//   UNDO [n] | REDO [n]    (deshace o rehace los últimos n cambios)
+//   VERSIONS               (versiones guardadas; '*' marca la actual)
+//   DIFF v1 [v2]           (cambios de v1 a v2, o a la actual: "+ nombre (padre)", "- nombre", "~ nombre A -> B")
+//   ASOF version [PLANO|TSV] (vista por generaciones del árbol en esa versión)
+//   PRE | IN | POST        (recorridos desde la raíz)
+// Las líneas vacías y las que empiezan con '#' se ignoran.
+struct InterpreteComandos {
+    Arbol& arbol;    // Árbol sobre el que se aplican los comandos
+    ostream* salida; // A dónde van los volcados (GEN, PRE, IN, POST)
+    bool permitirArchivos; // false en el servicio: los clientes no leen ni escriben archivos del servidor
+
+    explicit InterpreteComandos(Arbol& a, ostream& s = cout) : arbol(a), salida(&s), permitirArchivos(true) {}
+
+    // Indica si el comando lee o escribe un archivo (SAVE, LOAD, IMPORT, EXPORT a archivo, METRICS a archivo)
+    static bool usaArchivo(const vector<Token>& t) {
+        if (t[0].es("SAVE") || t[0].es("LOAD") || t[0].es("IMPORT")) return true;
+        if (t[0].es("EXPORT")) return t.size() >= 3 && !t[2].es("-");
+        if (t[0].es("METRICS")) return t.size() == 3;
+        return false;
+    }
+
+    // Lee un entero no negativo de un token
+    static bool leerNumero(const Token& t, long& numero) {
+        string n = t.str();
+        char* resto;
+        numero = strtol(n.c_str(), &resto, 10);
+        return !n.empty() && !*resto && numero >= 0;
+    }
+
+    // Ejecuta un comando. Si falla devuelve false y deja el motivo en 'mensaje'.
+    bool ejecutar(const vector<Token>& t, string& mensaje) {
+        if (t.empty() || t[0].texto[0] == '#') return true; // Línea vacía o comentario
+        if (!permitirArchivos && usaArchivo(t)) { mensaje = t[0].str() + " con archivos no esta permitido en el modo servicio."; return false; }
+
+        if (t[0].es("INSERT")) {
+            if (t.size() != 6) { mensaje = "Uso: INSERT nombre tipo genero estado padre|AUTO"; return false; }
+            if (arbol.buscar(t[1].texto, t[1].largo)) { mensaje = "Ya existe un personaje con ese nombre."; return false; }
+            int tipo = tipoDesdeTexto(t[2].texto, t[2].largo);
+            int genero = generoDesdeTexto(t[3].texto, t[3].largo);
+            int estado = estadoDesdeTexto(t[4].texto, t[4].largo);
+            if (tipo != TIPO_AGUA && tipo != TIPO_FUEGO) { mensaje = "Tipo invalido (Agua o Fuego)."; return false; }
+            if (genero != GENERO_HOMBRE && genero != GENERO_MUJER) { mensaje = "Genero invalido (Hombre o Mujer)."; return false; }
+            if (estado < 0) { mensaje = "Estado invalido (Vivo o Muerto)."; return false; }
+            if (t[5].es("AUTO")) {
+                Nodo* padre = arbol.elegirPadre();
+                if (!padre) { mensaje = "No hay padres disponibles."; return false; }
+                arbol.insertarNodo(t[1].texto, t[1].largo, (Tipo)tipo, (Genero)genero, (Estado)estado, padre);
+                return true;
+            }
+            Nodo* padre = arbol.buscar(t[5].texto, t[5].largo);
+            if (!padre) { mensaje = "No existe el padre " + t[5].str() + "."; return false; }
+            if (padre->hijos() >= MAX_HIJOS) { mensaje = "El padre " + t[5].str() + " ya tiene " + to_string(MAX_HIJOS) + " hijos."; return false; }
+            arbol.insertarNodo(t[1].texto, t[1].largo, (Tipo)tipo, (Genero)genero, (Estado)estado, padre);
+            return true;
+        }
+
+        if (t[0].es("POLICY")) { // POLICY [nivel|linajes|poblacion]
+            if (t.size() == 1) { *salida << "politica " << TEXTO_POLITICA[arbol.politica] << "\n"; return true; }
+            int politica = t.size() == 2 ? politicaDesdeTexto(t[1].texto, t[1].largo) : -1;
+            if (politica < 0) { mensaje = "Uso: POLICY [nivel|linajes|poblacion]"; return false; }
+            arbol.politica = (PoliticaUbicacion)politica;
+            return true;
+        }
+
+        if (t[0].es("DELETE")) {
+            if (t.size() != 2) { mensaje = "Uso: DELETE nombre"; return false; }
+            Nodo* objetivo = arbol.buscar(t[1].texto, t[1].largo);
+            if (!objetivo) { mensaje = "No existe ese personaje."; return false; }
+            const char* motivo = arbol.motivoNoEliminable(objetivo);
+            if (motivo) { mensaje = motivo; return false; }
+            arbol.eliminarNodo(objetivo);
+            return true;
+        }
+
+        if (t[0].es("SAVE") || t[0].es("LOAD") || t[0].es("IMPORT")) {
+            if (t.size() != 2) { mensaje = "Uso: " + t[0].str() + " archivo"; return false; }
+            string ruta = t[1].str();
+            if (!t[0].es("SAVE") && arbol.bitacora) { mensaje = t[0].str() + " no se puede usar con --journal activo."; return false; }
+            if (t[0].es("IMPORT")) return arbol.importarCsv(ruta.c_str(), mensaje);
+            return t[0].es("SAVE") ? arbol.guardarInstantanea(ruta.c_str(), mensaje)
+                                   : arbol.cargarInstantanea(ruta.c_str(), mensaje);
+        }
+
+        if (t[0].es("CLOCK")) { // CLOCK grueso|mono|sim
+            int modo = t.size() == 2 ? modoRelojDesdeTexto(t[1].texto, t[1].largo) : -1;
+            if (modo < 0) { mensaje = "Uso: CLOCK grueso|mono|sim"; return false; }
+            reloj.cambiarModo((ModoReloj)modo);
+            return true;
+        }
+
+        if (t[0].es("ADVANCE")) { // ADVANCE segundos (solo con el reloj simulado)
+            if (t.size() != 2) { mensaje = "Uso: ADVANCE segundos"; return false; }
+            if (reloj.modo != RELOJ_SIMULADO) { mensaje = "ADVANCE necesita el reloj simulado (CLOCK sim)."; return false; }
+            string n = t[1].str();
+            char* resto;
+            long segundos = strtol(n.c_str(), &resto, 10);
+            if (*resto || segundos < 0) { mensaje = "Cantidad de segundos invalida: " + n; return false; }
+            reloj.avanzar((int)segundos);
+            return true;
+        }
+
+        if (t[0].es("GEN")) { // GEN [PLANO|ANSI|TSV]: volcado por generaciones
+            FormatoSalida formato = FORMATO_PLANO;
+            if (t.size() == 2 && t[1].es("ANSI")) formato = FORMATO_ANSI;
+            else if (t.size() == 2 && t[1].es("TSV")) formato = FORMATO_TSV;
+            else if (t.size() != 1 && !(t.size() == 2 && t[1].es("PLANO"))) { mensaje = "Uso: GEN [PLANO|ANSI|TSV]"; return false; }
+            arbol.mostrarGeneraciones(*salida, formato);
+            return true;
+        }
+
+        if (t[0].es("ELIGIBLE")) { // Lista las hojas eliminables, una por línea
+            if (t.size() != 1) { mensaje = "Uso: ELIGIBLE"; return false; }
+            vector<Nodo*> lista;
+            arbol.hojasEliminables(lista);
+            Salida s(*salida);
+            for (size_t i = 0; i < lista.size(); i++) { s.texto(lista[i]->nombre, lista[i]->largo); s.caracter('\n'); }
+            return true;
+        }
+
+        if (t[0].es("METRICS")) { // METRICS [TABLA|PROM|JSON] [archivo]
+            int formato = METRICAS_PROMETHEUS;
+            if (t.size() >= 2) formato = valorDesdeTexto(TEXTO_FORMATO_METRICAS, 3, t[1].texto, t[1].largo);
+            if (formato < 0 || t.size() > 3) { mensaje = "Uso: METRICS [TABLA|PROM|JSON] [archivo]"; return false; }
+            if (t.size() == 3) return guardarMetricas(t[2].str(), arbol, (FormatoMetricas)formato, mensaje);
+            escribirMetricas(*salida, arbol, (FormatoMetricas)formato);
+            return true;
+        }
+
+        if (t[0].es("SET")) { // SET nombre Vivo|Muerto
+            int estado = t.size() == 3 ? estadoDesdeTexto(t[2].texto, t[2].largo) : -1;
+            if (estado < 0) { mensaje = "Uso: SET nombre Vivo|Muerto"; return false; }
+            Nodo* n = arbol.buscar(t[1].texto, t[1].largo);
+            if (!n) { mensaje = "No existe ese personaje."; return false; }
+            arbol.cambiarEstado(n, (Estado)estado);
+            return true;
+        }
+
+        if (t[0].es("COUNT") || t[0].es("FILTER")) { // Consultas sobre los mapas de bits de atributos
+            if (t.size() < 2) { mensaje = "Uso: " + t[0].str() + " consulta"; return false; }
+            const char* desde = t[1].texto; // Los tokens apuntan dentro de la misma línea: la consulta va de corrido
+            const char* hasta = t.back().texto + t.back().largo;
+            MapaBits resultado;
+            if (!arbol.atributos.consultar(desde, hasta - desde, resultado, mensaje)) return false;
+            Salida s(*salida);
+            if (t[0].es("COUNT")) { s.entero((long long)resultado.cantidad()); s.caracter('\n'); return true; }
+            resultado.recorrer([&](uint32_t id) {
+                Nodo* n = arbol.pool.nodo(id);
+                s.texto(n->nombre, n->largo);
+                s.caracter('\n');
+            });
+            return true;
+        }
+
+        if (t[0].es("PREFIX") || t[0].es("RANGE") || t[0].es("FUZZY")) { // Búsquedas por nombre
+            size_t fijos = t[0].es("RANGE") ? 3 : 2; // Argumentos obligatorios (con el comando)
+            string uso = t[0].es("PREFIX") ? "Uso: PREFIX texto [max]" : t[0].es("RANGE") ? "Uso: RANGE desde hasta [max]" : "Uso: FUZZY texto [dist]";
+            if (t.size() != fijos && t.size() != fijos + 1) { mensaje = uso; return false; }
+            long numero = t[0].es("FUZZY") ? 1 : -1; // -1: sin máximo
+            if (t.size() == fijos + 1) {
+                string n = t[fijos].str();
+                char* resto;
+                numero = strtol(n.c_str(), &resto, 10);
+                if (*resto || numero < 0) { mensaje = uso; return false; }
+            }
+            vector<Nodo*> lista;
+            vector<unsigned int> distancias;
+            const NombresOrdenados& orden = arbol.ordenNombres;
+            if (t[0].es("PREFIX")) orden.prefijo(t[1].texto, t[1].largo, lista, (size_t)numero);
+            else if (t[0].es("RANGE")) orden.rango(t[1].texto, t[1].largo, t[2].texto, t[2].largo, lista, (size_t)numero);
+            else orden.parecidos(t[1].texto, t[1].largo, (unsigned int)min(numero, 1000L), lista, distancias);
+            Salida s(*salida);
+            for (size_t i = 0; i < lista.size(); i++) {
+                s.texto(lista[i]->nombre, lista[i]->largo);
+                if (!distancias.empty()) { s.caracter('\t'); s.entero(distancias[i]); }
+                s.caracter('\n');
+            }
+            return true;
+        }
+
+        if (t[0].es("EXPORT")) { // EXPORT DOT|NDJSON|CSV archivo|- [nombre [niveles]]
+            string uso = "Uso: EXPORT DOT|NDJSON|CSV archivo|- [nombre [niveles]]";
+            int formato = t.size() >= 3 ? valorDesdeTexto(TEXTO_EXPORTACION, 3, t[1].texto, t[1].largo) : -1;
+            long niveles = -1;
+            if (formato < 0 || t.size() > 5 || (t.size() == 5 && !leerNumero(t[4], niveles))) { mensaje = uso; return false; }
+            Nodo* inicio = t.size() >= 4 ? arbol.buscar(t[3].texto, t[3].largo) : (Nodo*)arbol.raiz;
+            if (!inicio) { mensaje = "No existe ese personaje."; return false; }
+            int limite = (int)min(niveles, (long)INT_MAX);
+            if (t[2].es("-")) { arbol.exportar(*salida, (FormatoExportacion)formato, inicio, limite); return true; }
+            return arbol.exportarArchivo(t[2].str(), (FormatoExportacion)formato, inicio, limite, mensaje);
+        }
+
+        if (t[0].es("UNDO") || t[0].es("REDO")) { // UNDO [n] | REDO [n]: mueve el árbol n versiones (1 por omisión)
+            long pasos = 1;
+            if (t.size() > 2 || (t.size() == 2 && !leerNumero(t[1], pasos))) { mensaje = "Uso: " + t[0].str() + " [n]"; return false; }
+            long movidos = arbol.moverVersion(t[0].es("UNDO") ? pasos : -pasos, mensaje);
+            if (movidos < 0) return false;
+            if (movidos == 0) { mensaje = t[0].es("UNDO") ? "No hay cambios para deshacer." : "No hay cambios para rehacer."; return false; }
+            return true;
+        }
+
+        if (t[0].es("VERSIONS")) { // Una línea por versión: número, cambio y '*' en la actual
+            if (t.size() != 1) { mensaje = "Uso: VERSIONS"; return false; }
+            if (!arbol.historial) { mensaje = "El historial de versiones esta desactivado."; return false; }
+            const HistorialVersiones& h = *arbol.historial;
+            Salida s(*salida);
+            for (size_t i = 0; i < h.versiones.size(); i++) {
+                s.caracter(i == h.actual ? '*' : ' '); s.caracter(' ');
+                s.entero((long long)h.versiones[i].numero); s.caracter('\t');
+                s.texto(h.versiones[i].cambio); s.caracter('\n');
+            }
+            return true;
+        }
+
+        if (t[0].es("DIFF") || t[0].es("ASOF")) { // DIFF v1 [v2] | ASOF version [PLANO|TSV]
+            string uso = t[0].es("DIFF") ? "Uso: DIFF version [version]" : "Uso: ASOF version [PLANO|TSV]";
+            long a, b = -1;
+            if (t.size() < 2 || t.size() > 3 || !leerNumero(t[1], a)) { mensaje = uso; return false; }
+            if (!arbol.historial) { mensaje = "El historial de versiones esta desactivado."; return false; }
+            const HistorialVersiones& h = *arbol.historial;
+            FormatoSalida formato = FORMATO_PLANO;
+            if (t[0].es("DIFF")) {
+                if (t.size() == 3 && !leerNumero(t[2], b)) { mensaje = uso; return false; }
+                if (t.size() == 2) b = (long)h.numeroActual(); // Sin segunda versión: contra el árbol de ahora
+            } else if (t.size() == 3) {
+                if (t[2].es("TSV")) formato = FORMATO_TSV;
+                else if (!t[2].es("PLANO")) { mensaje = uso; return false; }
+            }
+            const NodoVersion* ra = h.raizDe((unsigned long long)a);
+            const NodoVersion* rb = t[0].es("DIFF") ? h.raizDe((unsigned long long)b) : NULL;
+            if (!ra || (t[0].es("DIFF") && !rb)) {
+                mensaje = "No existe la version " + to_string(ra ? b : a) + " (hay de la " + to_string(h.versiones.front().numero)
+                        + " a la " + to_string(h.versiones.back().numero) + ")."; return false;
+            }
+            Salida s(*salida);
+            if (t[0].es("ASOF")) { HistorialVersiones::escribirGeneraciones(s, ra, formato, yearsElapsed()); return true; }
+            HistorialVersiones::Diferencias d;
+            HistorialVersiones::diferencias(ra, rb, d);
+            HistorialVersiones::escribirDiferencias(s, d);
+            return true;
+        }
+
+        if (t[0].es("CULL")) { // Elimina todas las hojas eliminables (sin seguir con los padres)
+            if (t.size() != 1) { mensaje = "Uso: CULL"; return false; }
+            arbol.eliminarEliminables();
+            return true;
+        }
+
+        if (t[0].es("GET")) { // GET nombre: una fila TSV como las de GEN TSV
+            if (t.size() != 2) { mensaje = "Uso: GET nombre"; return false; }
+            GuardiaLectura guardia;
+            Nodo* n = arbol.buscar(t[1].texto, t[1].largo);
+            if (!n) { mensaje = "No existe ese personaje."; return false; }
+            Salida s(*salida);
+            Arbol::filaTSV(s, n, n->hijos(), yearsElapsed());
+            return true;
+        }
+
+        if (t[0].es("STATS")) { // STATS nombre: contadores del subárbol
+            if (t.size() != 2) { mensaje = "Uso: STATS nombre"; return false; }
+            Nodo* n = arbol.buscar(t[1].texto, t[1].largo);
+            if (!n) { mensaje = "No existe ese personaje."; return false; }
+            arbol.escribirAgregado(*salida, n);
+            return true;
+        }
+
+        if (t[0].es("KIN")) { // KIN a b: qué es a de b, grado y ancestro común
+            if (t.size() != 3) { mensaje = "Uso: KIN nombre nombre"; return false; }
+            Nodo* a = arbol.buscar(t[1].texto, t[1].largo);
+            Nodo* b = arbol.buscar(t[2].texto, t[2].largo);
+            if (!a || !b) { mensaje = "No existe " + (a ? t[2] : t[1]).str() + "."; return false; }
+            Nodo* c = arbol.ancestroComun(a, b);
+            *salida << t[1].str() << " es " << arbol.parentesco(a, b) << " de " << t[2].str()
+                    << " (grado " << arbol.distancia(a, b) << ", ancestro comun: " << c->nombre << ")\n";
+            return true;
+        }
+
+        if (t[0].es("TREE")) { // TREE [PLANO|ANSI]: diagrama vertical
+            FormatoSalida formato = FORMATO_ANSI;
+            if (t.size() == 2 && t[1].es("PLANO")) formato = FORMATO_PLANO;
+            else if (t.size() != 1 && !(t.size() == 2 && t[1].es("ANSI"))) { mensaje = "Uso: TREE [PLANO|ANSI]"; return false; }
+            arbol.mostrarArbolVertical(*salida, formato);
+            return true;
+        }
+
+        if (t[0].es("PRE") || t[0].es("IN") || t[0].es("POST")) { // Recorridos clásicos desde la raíz
+            if (t.size() != 1) { mensaje = "Uso: " + t[0].str(); return false; }
+            if (t[0].es("PRE")) arbol.preorden(*salida);
+            else if (t[0].es("IN")) arbol.inorden(*salida);
+            else arbol.postorden(*salida);
+            return true;
+        }
+
+        mensaje = "Comando desconocido: " + t[0].str();
+        return false;
+    }
+};
+
+// Aplica todos los comandos de 'archivo' sin menús ni preguntas. Los errores van a stderr
+// con su número de línea. Devuelve la cantidad de comandos que fallaron.
+long ejecutarLote(Arbol& arbol, FILE* archivo) {
+    LectorComandos lector(archivo);
+    lector.bitacora = arbol.bitacora;
+    InterpreteComandos interprete(arbol);
+    vector<Token> tokens;
+    string mensaje;
+    long errores = 0;
+    arbol.diferirAgregados(true); // Un lote puede traer millones de INSERT: contadores al final (o en STATS)
+    while (lector.leerLinea(tokens)) {
+        if (!interprete.ejecutar(tokens, mensaje)) {
+            errores++;
+            fprintf(stderr, "Linea %ld: %s\n", lector.linea, mensaje.c_str());
+        }
+    }
+    arbol.diferirAgregados(false);
+    return errores;
+}
+
+// --------------------------------------
+// MODO SERVICIO (socket local con epoll)
+// --------------------------------------
+// Protocolo: una petición por línea, con los mismos comandos que el modo por lotes. Cada
+// petición recibe, en orden, una respuesta:
+//   OK <bytes>\n<bytes de datos>     (los datos son lo que el comando escribe; pueden ser 0)
+//   ERR <motivo>\n
+// Un cliente puede mandar muchas líneas juntas sin esperar respuestas (pipelining). Las líneas
+// vacías y los comentarios no tienen respuesta. QUIT responde OK 0 y cierra la conexión.
+// Todo corre en el hilo del bucle de eventos: lecturas y escrituras se atienden de a una.
+// Los comandos con archivos (SAVE, LOAD, IMPORT, EXPORT y METRICS a un archivo) responden ERR:
+// EXPORT ... - y METRICS sin archivo devuelven los datos en la respuesta.
+
+// streambuf que agrega todo lo que se escribe al final de un string
+struct BufferTexto : streambuf {
+    string* destino;
+    BufferTexto() : destino(NULL) {}
+    int overflow(int c) { if (c != EOF) destino->push_back((char)c); return c; }
+    streamsize xsputn(const char* s, streamsize n) { destino->append(s, (size_t)n); return n; }
+};
+
+#ifdef __linux__
+volatile sig_atomic_t servicioTerminar = 0; // Lo pone SIGINT/SIGTERM: el servicio guarda y termina
+void pedirFinServicio(int) { servicioTerminar = 1; }
+
+struct ServicioArbol {
+    static const size_t MAX_PENDIENTE = 8 << 20; // Con más respuestas sin enviar se deja de leer a ese cliente
+    static const size_t MAX_LINEA = 1 << 20;     // Una petición más larga cierra la conexión
+
+    struct Conexion {
+        int fd;
+        string entrada;    // Bytes recibidos que todavía no forman una línea completa
+        string salida;     // Respuestas pendientes de enviar
+        size_t enviado;    // Bytes de 'salida' ya enviados
+        bool cerrar;       // Cerrar cuando se termine de enviar 'salida'
+        bool tocada;       // Tiene respuestas nuevas en esta vuelta del bucle
+        unsigned int eventos; // Eventos de epoll registrados ahora
+    };
+
+    Arbol& arbol;
+    InterpreteComandos interprete;
+    BufferTexto bufferCuerpo;
+    ostream cuerpoSalida;      // Donde el intérprete escribe los datos de la respuesta
+    string cuerpo;
+    vector<Token> tokens;
+    string mensaje;
+    int epfd, escucha;
+    string rutaUnix;           // Se borra al terminar (si es un socket Unix)
+    vector<Conexion*> conexiones; // Por número de descriptor
+    vector<Conexion*> tocadas;    // Conexiones con respuestas nuevas en esta vuelta
+
+    explicit ServicioArbol(Arbol& a) : arbol(a), interprete(a), cuerpoSalida(&bufferCuerpo), epfd(-1), escucha(-1) {
+        bufferCuerpo.destino = &cuerpo;
+        interprete.salida = &cuerpoSalida;
+        interprete.permitirArchivos = false; // Cualquier proceso que llegue al socket podría pisar archivos o reemplazar el árbol
+    }
+
+    ~ServicioArbol() {
+        for (size_t i = 0; i < conexiones.size(); i++) if (conexiones[i]) { close(conexiones[i]->fd); delete conexiones[i]; }
+        if (escucha >= 0) close(escucha);
+        if (epfd >= 0) close(epfd);
+        if (!rutaUnix.empty()) unlink(rutaUnix.c_str());
+    }
+
+    bool abrirUnix(const char* ruta) {
+        sockaddr_un dir;
+        if (strlen(ruta) >= sizeof(dir.sun_path)) { fprintf(stderr, "Ruta de socket demasiado larga: %s\n", ruta); return false; }
+        memset(&dir, 0, sizeof(dir));
+        dir.sun_family = AF_UNIX;
+        strcpy(dir.sun_path, ruta);
+        escucha = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        unlink(ruta); // Un socket viejo de otra ejecución impediría el bind
+        if (escucha < 0 || bind(escucha, (sockaddr*)&dir, sizeof(dir)) < 0 || listen(escucha, 128) < 0) {
+            perror("socket unix");
+            return false;
+        }
+        rutaUnix = ruta;
+        return true;
+    }
+
+    bool abrirTcp(int puerto) { // Solo 127.0.0.1: el servicio es para procesos de la misma máquina
+        sockaddr_in dir;
+        memset(&dir, 0, sizeof(dir));
+        dir.sin_family = AF_INET;
+        dir.sin_port = htons((uint16_t)puerto);
+        dir.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        escucha = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int si = 1;
+        if (escucha >= 0) setsockopt(escucha, SOL_SOCKET, SO_REUSEADDR, &si, sizeof(si));
+        if (escucha < 0 || bind(escucha, (sockaddr*)&dir, sizeof(dir)) < 0 || listen(escucha, 128) < 0) {
+            perror("socket tcp");
+            return false;
+        }
+        return true;
+    }
+
+    void vigilar(Conexion* c, unsigned int eventos) { // Cambia los eventos de epoll solo si hace falta
+        if (c->eventos == eventos) return;
+        epoll_event ev;
+        ev.events = eventos;
+        ev.data.fd = c->fd;
+        epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+        c->eventos = eventos;
+    }
+
+    void aceptar() {
+        for (;;) {
+            int fd = accept4(escucha, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return; // EAGAIN: no hay más clientes esperando
+            int si = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &si, sizeof(si)); // Falla sin daño en sockets Unix
+            Conexion* c = new Conexion();
+            c->fd = fd;
+            c->enviado = 0;
+            c->cerrar = false;
+            c->tocada = false;
+            c->eventos = EPOLLIN;
+            if ((size_t)fd >= conexiones.size()) conexiones.resize(fd + 1, NULL);
+            conexiones[fd] = c;
+            epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.fd = fd;
+            epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+        }
+    }
+
+    void cerrarConexion(Conexion* c) {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+        close(c->fd);
+        conexiones[c->fd] = NULL;
+        delete c;
+    }
+
+    // Ejecuta todas las líneas completas recibidas y deja sus respuestas en c->salida
+    void atender(Conexion* c) {
+        size_t inicio = 0;
+        for (;;) {
+            const char* desde = c->entrada.data() + inicio;
+            const char* salto = (const char*)memchr(desde, '\n', c->entrada.size() - inicio);
+            if (!salto) break;
+            tokens.clear();
+            LectorComandos::separar(desde, salto, tokens);
+            inicio = (size_t)(salto - c->entrada.data()) + 1;
+            if (tokens.empty() || tokens[0].texto[0] == '#') continue; // Sin respuesta
+            if (tokens[0].es("QUIT")) { c->salida += "OK 0\n"; c->cerrar = true; break; }
+            cuerpo.clear();
+            if (interprete.ejecutar(tokens, mensaje)) {
+                cuerpoSalida.flush();
+                char cabecera[32];
+                snprintf(cabecera, sizeof(cabecera), "OK %lu\n", (unsigned long)cuerpo.size());
+                c->salida += cabecera;
+                c->salida += cuerpo;
+            } else {
+                c->salida += "ERR " + mensaje + "\n";
+            }
+        }
+        c->entrada.erase(0, inicio);
+        if (c->entrada.size() > MAX_LINEA) { c->salida += "ERR Linea demasiado larga.\n"; c->cerrar = true; }
+        if (!c->tocada) { c->tocada = true; tocadas.push_back(c); }
+    }
+
+    void leer(Conexion* c) {
+        char buf[65536];
+        for (;;) {
+            ssize_t r = read(c->fd, buf, sizeof(buf));
+            if (r > 0) { c->entrada.append(buf, (size_t)r); if (c->salida.size() - c->enviado > MAX_PENDIENTE) break; continue; }
+            if (r == 0) c->cerrar = true;                                     // El cliente cerró su lado
+            else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) c->cerrar = true;
+            break;
+        }
+        atender(c);
+    }
+
+    // Envía lo que se pueda. Devuelve false si la conexión se cerró.
+    bool enviar(Conexion* c) {
+        while (c->enviado < c->salida.size()) {
+            ssize_t w = send(c->fd, c->salida.data() + c->enviado, c->salida.size() - c->enviado, MSG_NOSIGNAL);
+            if (w > 0) { c->enviado += (size_t)w; continue; }
+            if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (w < 0 && errno == EINTR) continue;
+            cerrarConexion(c);
+            return false;
+        }
+        if (c->enviado == c->salida.size()) {
+            c->salida.clear();
+            c->enviado = 0;
+            if (c->cerrar) { cerrarConexion(c); return false; }
+        }
+        size_t pendiente = c->salida.size() - c->enviado;
+        unsigned int eventos = (pendiente ? (unsigned int)EPOLLOUT : 0u) | (pendiente <= MAX_PENDIENTE && !c->cerrar ? (unsigned int)EPOLLIN : 0u);
+        vigilar(c, eventos);
+        return true;
+    }
+
+    // Bucle principal: termina con SIGINT/SIGTERM
+    int ejecutar() {
+        epfd = epoll_create1(EPOLL_CLOEXEC);
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = escucha;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, escucha, &ev);
+        signal(SIGINT, pedirFinServicio);
+        signal(SIGTERM, pedirFinServicio);
+        epoll_event listos[256];
+        while (!servicioTerminar) {
+            int n = epoll_wait(epfd, listos, 256, -1);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                perror("epoll_wait");
+                return 1;
+            }
+            reloj.refrescar(); // Cada vuelta del bucle es un lote para el reloj grueso
+            for (int i = 0; i < n; i++) {
+                int fd = listos[i].data.fd;
+                if (fd == escucha) { aceptar(); continue; }
+                Conexion* c = (size_t)fd < conexiones.size() ? conexiones[fd] : NULL;
+                if (!c) continue;
+                if (listos[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) leer(c);
+                else if (!c->tocada) { c->tocada = true; tocadas.push_back(c); } // Solo EPOLLOUT
+            }
+            // Las respuestas salen después de confirmar la bitácora: un OK nunca precede al fsync
+            if (arbol.bitacora) arbol.bitacora->confirmar();
+            for (size_t i = 0; i < tocadas.size(); i++) {
+                tocadas[i]->tocada = false;
+                enviar(tocadas[i]);
+            }
+            tocadas.clear();
+        }
+        return 0;
+    }
+};
+#endif
+
+// --------------------------------------
+// BENCHMARK DE BÚSQUEDA (índice hash vs BFS)
+// --------------------------------------
+// Construye un árbol completo con 'n' personajes extra (P0, P1, ...) colgados en orden por niveles
+void construirArbolSintetico(Arbol& arbol, int n) {
+    for (int i = 0; i < n; i++)
+        arbol.insertarNodo("P" + to_string(i), (i % 2 ? TIPO_FUEGO : TIPO_AGUA),
+                           (i % 3 ? GENERO_HOMBRE : GENERO_MUJER), ESTADO_VIVO, arbol.primerPadreDisponible());
+}
+
+// Construye una cadena de 'n' personajes (C0, C1, ...), cada uno hijo único del anterior: el peor caso de profundidad
+void construirCadenaSintetica(Arbol& arbol, int n) {
+    Nodo* padre = arbol.raiz->izquierda;
+    arbol.diferirAgregados(true); // Sin esto cada inserción recorrería toda la cadena
+    for (int i = 0; i < n; i++)
+        padre = arbol.insertarNodo("C" + to_string(i), TIPO_AGUA, GENERO_MUJER, ESTADO_VIVO, padre);
+    arbol.diferirAgregados(false);
+}
+
+// Mide el tiempo promedio por búsqueda con el índice hash y con el BFS original
+void benchmarkBusqueda(int n) {
+    Arbol arbol;
+    construirArbolSintetico(arbol, n);
+
+    int consultas = 1000;                 // Cantidad de nombres a buscar (repartidos por todo el árbol)
+    vector<string> nombres;
+    for (int i = 0; i < consultas; i++) nombres.push_back("P" + to_string((long long)i * n / consultas));
+
+    size_t encontrados = 0; // Evita que el compilador descarte las búsquedas
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    for (int r = 0; r < 1000; r++)
+        for (int i = 0; i < consultas; i++) encontrados += (arbol.buscar(nombres[i]) != NULL);
+    chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+    double nsHash = chrono::duration<double, nano>(t1 - t0).count() / (1000.0 * consultas);
+
+    int consultasBFS = n > 100000 ? 20 : 200; // El BFS es O(n): se hacen menos consultas en árboles grandes
+    t0 = chrono::steady_clock::now();
+    for (int i = 0; i < consultasBFS; i++) encontrados += (arbol.buscarBFS(nombres[i * consultas / consultasBFS]) != NULL);
+    t1 = chrono::steady_clock::now();
+    double nsBFS = chrono::duration<double, nano>(t1 - t0).count() / consultasBFS;
+
+    cout << "Nodos: " << n + 3
+         << " | Hash: " << nsHash << " ns/busqueda"
+         << " | BFS: " << nsBFS << " ns/busqueda"
+         << " | Aceleracion: x" << (nsHash > 0 ? nsBFS / nsHash : 0)
+         << " | (encontrados: " << encontrados << ")\n";
+}
+
+// --------------------------------------
+// SUITE DE BENCHMARKS (--bench)
+// --------------------------------------
+// Para la columna asignaciones_op se compila aparte con -DCONTAR_ASIGNACIONES; sin esa opción
+// las asignaciones salen como -1 y el resto de las columnas no cambia. Las filas generico* salen
+// solo compilando con -DARBOL_GENERICO.
+
+// Destino de salida que descarta todo: se paga el formateo pero no la consola
+struct BufferNulo : streambuf {
+    int overflow(int c) { return c; }
+    streamsize xsputn(const char*, streamsize n) { return n; }
+};
+
+// Los resultados medidos terminan en una variable volatile: así el compilador no puede descartar el cálculo
+volatile size_t sumidero;
+void consumirResultado(size_t valor) { sumidero = valor; }
+
+// Crea un archivo temporal vacío (en TMPDIR o /tmp) y devuelve su ruta; "" si no se pudo
+string crearTemporal(const char* prefijo) {
+#ifdef _WIN32
+    (void)prefijo;
+    char nombre[L_tmpnam];
+    if (!tmpnam(nombre)) return "";
+    FILE* f = fopen(nombre, "wb");
+    if (!f) return "";
+    fclose(f);
+    return nombre;
+#else
+    const char* carpeta = getenv("TMPDIR");
+    string plantilla = string(carpeta && *carpeta ? carpeta : "/tmp") + "/" + prefijo + "XXXXXX";
+    vector<char> ruta(plantilla.begin(), plantilla.end());
+    ruta.push_back('\0');
+    int fd = mkstemp(&ruta[0]); // Nombre único, creado sin pisar ningún archivo existente
+    if (fd < 0) return "";
+    close(fd);
+    return &ruta[0];
+#endif
+}
+
+// Resultado de medir una operación sobre un árbol de 'nodos' personajes
+struct ResultadoBench {
+    string operacion;
+    long long nodos;
+    double nsOp;           // Nanosegundos por operación
+    double asignacionesOp; // Llamadas a new por operación (-1: compilado sin CONTAR_ASIGNACIONES)
+    long rssPicoKb;        // Memoria máxima del proceso al terminar la medición
+};
+
+// Repite 'f' (que hace 'opsPorLlamada' operaciones) hasta juntar 'minimoMs' milisegundos y
+// agrega al resultado los nanosegundos y las asignaciones por operación
+template <class F>
+void medir(const char* operacion, long long nodos, long long opsPorLlamada, int minimoMs, F f, vector<ResultadoBench>& resultados) {
+    unsigned long long asignaciones0 = totalAsignaciones.load(memory_order_relaxed);
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    long long llamadas = 0;
+    chrono::steady_clock::duration transcurrido;
+    do {
+        f();
+        llamadas++;
+        transcurrido = chrono::steady_clock::now() - t0;
+    } while (transcurrido < chrono::milliseconds(minimoMs));
+    double ops = (double)llamadas * opsPorLlamada;
+    ResultadoBench r;
+    r.operacion = operacion;
+    r.nodos = nodos;
+    r.nsOp = chrono::duration<double, nano>(transcurrido).count() / ops;
+    r.asignacionesOp = CONTANDO_ASIGNACIONES ? (totalAsignaciones.load(memory_order_relaxed) - asignaciones0) / ops : -1;
+    r.rssPicoKb = memoriaPicoKb();
+    resultados.push_back(r);
+}
+
+// Lectores concurrentes: 'hilos' hilos buscan nombres sin cerrojos (solo GuardiaLectura)
+// mientras un escritor inserta y elimina sin parar. ns_op es el tiempo total dividido por todas
+// las búsquedas: si la lectura escala con los núcleos, baja a la mitad al duplicar los hilos.
+void medirLectoresConcurrentes(Arbol& arbol, const vector<string>& nombres, int hilos, long long nodos, vector<ResultadoBench>& res) {
+    const long long POR_HILO = 200000; // Búsquedas de cada lector por llamada
+    atomic<bool> parar(false);
+    atomic<size_t> basura(0);
+    thread escritor([&]() {
+        unsigned long k = 0;
+        while (!parar.load(memory_order_relaxed)) {
+            lock_guard<mutex> cerrojo(arbol.escritura);
+            string nombre = "W" + to_string(k++);
+            Nodo* n = arbol.insertarNodo(nombre, TIPO_FUEGO, GENERO_MUJER, ESTADO_VIVO, arbol.primerPadreDisponible());
+            arbol.eliminarNodo(n); // Pasa por la lista de retiro: se libera cuando ningún lector lo vea
+        }
+    });
+    string operacion = "buscar_concurrente_" + to_string(hilos);
+    medir(operacion.c_str(), nodos, POR_HILO * hilos, 100, [&]() {
+        vector<thread> lectores;
+        for (int h = 0; h < hilos; h++)
+            lectores.push_back(thread([&, h]() {
+                size_t encontrados = 0;
+                for (long long i = 0; i < POR_HILO; i += 1000) {
+                    GuardiaLectura guardia; // Una guardia por cada 1000 búsquedas
+                    for (long long j = i; j < i + 1000; j++)
+                        encontrados += arbol.buscar(nombres[(size_t)(j * 31 + h) % nombres.size()]) != NULL;
+                }
+                basura += encontrados;
+            }));
+        for (size_t h = 0; h < lectores.size(); h++) lectores[h].join();
+    }, res);
+    parar = true;
+    escritor.join();
+    lock_guard<mutex> cerrojo(arbol.escritura);
+    arbol.retiro.recolectar();
+    consumirResultado(basura);
+}
+
+#ifdef ARBOL_GENERICO
+// Carga de los árboles genéricos del bench: un personaje sin nombre (número, tipo, género y estado)
+struct CargaBench {
+    unsigned int numero;
+    unsigned char tipo, genero, estado;
+};
+
+// Inserta n nodos en un ArbolGenerico y lo recorre en preorden. Con límite cada nodo va bajo el
+// primer padre disponible (como "insertar" en Arbol); sin límite, en familias de 8 hijos.
+template <int MaxHijos>
+void medirArbolGenerico(const char* nombre, long long n, vector<ResultadoBench>& res) {
+    typedef ArbolGenerico<CargaBench, MaxHijos> ArbolT;
+    CargaBench carga = { 0, TIPO_AGUA, GENERO_HOMBRE, ESTADO_VIVO };
+    ArbolT arbol(carga);
+    vector<typename ArbolT::NodoT*> nodos(1, arbol.raiz);
+    string operacion = string(nombre) + "_insertar";
+    medir(operacion.c_str(), n + 1, n, 0, [&]() { // Una sola vez
+        for (long long i = 1; i <= n; i++) {
+            carga.numero = (unsigned int)i;
+            carga.tipo = (unsigned char)(i % 3);
+            typename ArbolT::NodoT* padre = MaxHijos > 0 ? arbol.primerPadreDisponible() : nodos[(size_t)(i - 1) / 8];
+            nodos.push_back(arbol.insertar(padre, carga));
+        }
+    }, res);
+    size_t basura = 0;
+    operacion = string(nombre) + "_preorden";
+    medir(operacion.c_str(), n + 1, 1, 100, [&]() { ArbolT::recorrer(arbol.raiz, PREORDEN, [&](typename ArbolT::NodoT* x) { basura += x->carga.numero; }); }, res);
+    consumirResultado(basura);
+}
+#endif // ARBOL_GENERICO
+
+// Mide todas las operaciones del árbol para tamaños 10^3, 10^4, ... hasta 'maximo'
+vector<ResultadoBench> ejecutarSuiteBench(long long maximo) {
+    vector<ResultadoBench> res;
+    BufferNulo bufferNulo;
+    ostream nulo(&bufferNulo);
+    for (long long n = 1000; n <= maximo; n *= 10) {
+        Arbol arbol;
+        long long nodos = n + 3; // Los personajes sintéticos más Asteroide, Agua y Fuego
+        medir("insertar", nodos, n, 0, [&]() { construirArbolSintetico(arbol, (int)n); }, res); // Una sola vez
+
+        // El mismo árbol exportado como CSV y vuelto a leer
+        string rutaCsv = crearTemporal("bench_importar");
+        string errorExportar;
+        if (!rutaCsv.empty() && arbol.exportarArchivo(rutaCsv, EXPORTAR_CSV, arbol.raiz, -1, errorExportar)) {
+            Arbol importado;
+            string errorCsv;
+            medir("importar_csv", nodos, nodos, 0, [&]() { importado.importarCsv(rutaCsv.c_str(), errorCsv); }, res);
+        }
+        if (!rutaCsv.empty()) remove(rutaCsv.c_str());
+
+        vector<string> nombres; // Nombres existentes repartidos por todo el árbol
+        for (int i = 0; i < 1000; i++) nombres.push_back("P" + to_string((i * 7919LL) % n));
+        size_t basura = 0;      // Evita que el compilador descarte los resultados
+        medir("buscar", nodos, 1000, 100, [&]() { for (size_t i = 0; i < nombres.size(); i++) basura += arbol.buscar(nombres[i]) != NULL; }, res);
+        vector<Nodo*> encontrados;
+        vector<unsigned int> distancias;
+        medir("buscar_prefijo", nodos, 1000, 100, [&]() { // Hasta 10 nombres por prefijo (autocompletar)
+            for (size_t i = 0; i < nombres.size(); i++) { encontrados.clear(); basura += arbol.ordenNombres.prefijo(nombres[i].data(), 3, encontrados, 10); }
+        }, res);
+        medir("buscar_parecidos", nodos, 100, 100, [&]() { // Un error de tipeo, distancia 1
+            for (size_t i = 0; i < 100; i++) {
+                string s = nombres[i] + "x";
+                encontrados.clear();
+                basura += arbol.ordenNombres.parecidos(s.data(), s.size(), 1, encontrados, distancias);
+            }
+        }, res);
+        medir("contar_atributos", nodos, 1, 100, [&]() { // Tres valores combinados, como COUNT
+            MapaBits m;
+            string error;
+            arbol.atributos.consultar("Agua AND Mujer AND NOT Muerto", 29, m, error);
+            basura += m.cantidad();
+        }, res);
+        medir("padresDisponibles", nodos, 1, 100, [&]() { basura += arbol.padresDisponibles().size(); }, res);
+        medir("primerPadreDisponible", nodos, 1000, 100, [&]() { for (int i = 0; i < 1000; i++) basura += arbol.primerPadreDisponible()->largo; }, res);
+        for (int p = UBICAR_NIVEL; p <= UBICAR_POBLACION; p++) { // Padre de INSERT ... AUTO con cada política
+            arbol.politica = (PoliticaUbicacion)p;
+            string operacion = "elegirPadre_" + TEXTO_POLITICA[p];
+            medir(operacion.c_str(), nodos, 1000, 100, [&]() { for (int i = 0; i < 1000; i++) basura += arbol.elegirPadre()->largo; }, res);
+        }
+        arbol.politica = UBICAR_NIVEL;
+        medir("mostrarGeneraciones", nodos, 1, 100, [&]() { arbol.mostrarGeneraciones(nulo); }, res);
+        medir("preorden", nodos, 1, 100, [&]() { arbol.preorden(nulo); }, res);
+        medir("inorden", nodos, 1, 100, [&]() { arbol.inorden(nulo); }, res);
+        medir("postorden", nodos, 1, 100, [&]() { arbol.postorden(nulo); }, res);
+        medir("recorrer_preorden", nodos, 1, 100, [&]() { recorrer(arbol.raiz, PREORDEN, [&](Nodo* x) { basura += x->largo; }); }, res); // Sin iostream
+        medir("mostrarArbolVertical", nodos, 1, 100, [&]() { arbol.mostrarArbolVertical(nulo); }, res);
+        medir("exportar_ndjson", nodos, 1, 100, [&]() { arbol.exportar(nulo, EXPORTAR_NDJSON, arbol.raiz); }, res);
+        int nucleos = max(1, (int)thread::hardware_concurrency());
+        for (int hilos = 1; hilos <= min(nucleos, 64); hilos *= 2)
+            medirLectoresConcurrentes(arbol, nombres, hilos, nodos, res);
+
+        vector<Nodo*> hojas; // Hojas a eliminar (se saltea la regla de los 60 años: se mide la operación)
+        for (set<Nodo*, Arbol::PorNivel>::reverse_iterator it = arbol.libres.rbegin();
+             it != arbol.libres.rend() && (long long)hojas.size() < min(n / 2, 10000LL); ++it)
+            if ((*it)->hijos() == 0) hojas.push_back(*it);
+        medir("eliminar", nodos, (long long)hojas.size(), 0, [&]() { for (size_t i = 0; i < hojas.size(); i++) arbol.eliminarNodo(hojas[i]); }, res);
+        consumirResultado(basura);
+
+        Arbol cadena; // Árbol degenerado de profundidad n (antes desbordaba la pila de los recorridos recursivos)
+        construirCadenaSintetica(cadena, (int)n);
+        medir("preorden_cadena", nodos, 1, 100, [&]() { cadena.preorden(nulo); }, res);
+        medir("postorden_cadena", nodos, 1, 100, [&]() { cadena.postorden(nulo); }, res);
+
+#ifdef ARBOL_GENERICO
+        // El mismo tamaño en árboles genéricos: binario (comparar con recorrer_preorden), de 4 hijos y sin límite
+        medirArbolGenerico<2>("generico2", n, res);
+        medirArbolGenerico<4>("generico4", n, res);
+        medirArbolGenerico<0>("generico_hermanos", n, res);
+#endif
+    }
+    return res;
+}
+
+// Escribe un resultado como una línea JSON
+void escribirResultadoBench(ostream& out, const ResultadoBench& r) {
+    char linea[256];
+    snprintf(linea, sizeof(linea), "{\"operacion\":\"%s\",\"nodos\":%lld,\"ns_op\":%.2f,\"asignaciones_op\":%.3f,\"rss_pico_kb\":%ld}",
+             r.operacion.c_str(), r.nodos, r.nsOp, r.asignacionesOp, r.rssPicoKb);
+    out << linea << "\n";
+}
+
+// Lee una línea base escrita por escribirResultadoBench (las líneas que no se entienden se ignoran)
+vector<ResultadoBench> leerLineaBase(const char* ruta) {
+    vector<ResultadoBench> base;
+    ifstream archivo(ruta);
+    string linea;
+    while (getline(archivo, linea)) {
+        char operacion[64];
+        ResultadoBench r;
+        if (sscanf(linea.c_str(), "{\"operacion\":\"%63[^\"]\",\"nodos\":%lld,\"ns_op\":%lf,\"asignaciones_op\":%lf,\"rss_pico_kb\":%ld",
+                   operacion, &r.nodos, &r.nsOp, &r.asignacionesOp, &r.rssPicoKb) == 5) {
+            r.operacion = operacion;
+            base.push_back(r);
+        }
+    }
+    return base;
+}
+
+// Compara contra la línea base; informa por stderr las operaciones más lentas que la tolerancia
+// (en porcentaje) y devuelve cuántas hay
+int compararConLineaBase(const vector<ResultadoBench>& actual, const vector<ResultadoBench>& base, double tolerancia) {
+    int regresiones = 0;
+    for (size_t i = 0; i < actual.size(); i++)
+        for (size_t j = 0; j < base.size(); j++)
+            if (base[j].operacion == actual[i].operacion && base[j].nodos == actual[i].nodos && base[j].nsOp > 0) {
+                double cambio = (actual[i].nsOp / base[j].nsOp - 1.0) * 100.0;
+                if (cambio > tolerancia) {
+                    fprintf(stderr, "REGRESION %s (%lld nodos): %.2f ns/op contra %.2f de la linea base (%+.1f%%)\n",
+                            actual[i].operacion.c_str(), actual[i].nodos, actual[i].nsOp, base[j].nsOp, cambio);
+                    regresiones++;
+                }
+            }
+    return regresiones;
+}
+
+// Carga la instantánea al iniciar (si el archivo existe) y la guarda al salir. Con bitácora,
+// al iniciar aplica los cambios registrados después de la instantánea y cada instantánea
+// guardada deja la bitácora vacía (punto de control).
+struct InstantaneaDeSesion {
+    Arbol& arbol;
+    const char* ruta;         // NULL si no se pidió --snapshot
+    const char* rutaBitacora; // NULL si no se pidió --journal
+    Bitacora bitacora;
+
+    InstantaneaDeSesion(Arbol& a, const char* r, const char* rb) : arbol(a), ruta(r), rutaBitacora(rb) {}
+
+    ~InstantaneaDeSesion() {
+        arbol.bitacora = NULL;
+    }
+
+    // Devuelve false si el archivo existe pero no se pudo cargar o recuperar
+    bool cargar() {
+        if (!ruta) return true;
+        string error;
+        FILE* f = fopen(ruta, "rb");
+        if (f) { // Si todavía no hay instantánea se empieza con el árbol inicial
+            fclose(f);
+            if (!arbol.cargarInstantanea(ruta, error)) {
+                fprintf(stderr, "No se pudo cargar la instantanea %s: %s\n", ruta, error.c_str());
+                return false;
+            }
+        }
+        if (!rutaBitacora) return true;
+
+        long aplicadas;
+        arbol.diferirAgregados(true); // La recuperación es una carga masiva: contadores al final
+        bool recuperada = arbol.reproducirBitacora(rutaBitacora, aplicadas, error);
+        arbol.diferirAgregados(false);
+        if (!recuperada) {
+            fprintf(stderr, "No se pudo recuperar la bitacora %s: %s\n", rutaBitacora, error.c_str());
+            return false;
+        }
+        if (aplicadas > 0) {
+            fprintf(stderr, "Recuperadas %ld operaciones de la bitacora.\n", aplicadas);
+            if (!arbol.guardarInstantanea(ruta, error)) { // Punto de control antes de vaciar la bitácora
+                fprintf(stderr, "No se pudo guardar la instantanea: %s\n", error.c_str());
+                return false;
+            }
+        }
+        if (!bitacora.abrir(rutaBitacora, true)) {
+            fprintf(stderr, "No se pudo abrir la bitacora %s\n", rutaBitacora);
+            return false;
+        }
+        arbol.bitacora = &bitacora;
+        return true;
+    }
+
+    bool guardar() {
+        if (!ruta) return true;
+        string error;
+        if (rutaBitacora) bitacora.confirmar(); // Lo registrado queda a salvo aunque falle la instantánea
+        if (!arbol.guardarInstantanea(ruta, error)) {
+            fprintf(stderr, "No se pudo guardar la instantanea: %s\n", error.c_str());
+            return false;
+        }
+        if (rutaBitacora && !bitacora.abrir(rutaBitacora, true)) { // La instantánea ya incluye todo lo registrado
+            fprintf(stderr, "No se pudo abrir la bitacora %s\n", rutaBitacora);
+            return false;
+        }
+        return true;
+    }
+};
+
+// --------------------------------------
+// MAIN
+// --------------------------------------
+int main(int argc, char* argv[]) {
+    const char* archivoLote = NULL;        // --batch archivo   (use "-" para leer de la entrada estándar)
+    const char* socketServicio = NULL;     // --serve ruta       (servicio por socket Unix)
+    int puertoServicio = 0;                // --serve-tcp puerto (servicio por TCP en 127.0.0.1)
+    const char* archivoInstantanea = NULL; // --snapshot archivo (se carga al iniciar y se guarda al salir)
+    const char* archivoBitacora = NULL;    // --journal archivo  (registra cada cambio; requiere --snapshot)
+    int grupoOperaciones = 64;             // --group-commit n   (registros por fsync)
+    int grupoMilisegundos = 50;            // --group-ms t       (tiempo máximo sin confirmar)
+    long long benchMaximo = 0;             // --bench [n]        (suite de benchmarks hasta n nodos)
+    const char* benchSalida = NULL;        // --bench-out archivo (resultados en JSON, uno por línea)
+    const char* benchBase = NULL;          // --baseline archivo (resultados anteriores para comparar)
+    double benchTolerancia = 10.0;         // --tolerance pct    (más lento que esto es una regresión)
+    const char* archivoMetricas = NULL;    // --metrics archivo  (volcado de métricas al terminar; .json o Prometheus)
+    long maximoVersiones = 10000;          // --versions n       (versiones para deshacer; 0 las desactiva)
+    const char* archivoImportar = NULL;    // --import archivo   (reemplaza el árbol por un CSV/TSV al iniciar)
+    PoliticaUbicacion politica = UBICAR_NIVEL; // --policy nivel|linajes|poblacion (padre de INSERT ... AUTO)
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench-buscar") == 0) { // Modo benchmark: ./programa --bench-buscar [n]
+            int n = (i + 1 < argc ? atoi(argv[i + 1]) : 100000);
+            for (int tam = 1000; tam <= n; tam *= 10) benchmarkBusqueda(tam);
+            return 0;
+        }
+        else if (strcmp(argv[i], "--bench") == 0) benchMaximo = (i + 1 < argc && argv[i + 1][0] != '-') ? atoll(argv[++i]) : 1000000;
+        else if (strcmp(argv[i], "--bench-out") == 0 && i + 1 < argc) benchSalida = argv[++i];
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) benchBase = argv[++i];
+        else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) benchTolerancia = atof(argv[++i]);
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) archivoLote = argv[++i];
+        else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) socketServicio = argv[++i];
+        else if (strcmp(argv[i], "--serve-tcp") == 0 && i + 1 < argc) puertoServicio = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc) archivoInstantanea = argv[++i];
+        else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) archivoMetricas = argv[++i];
+        else if (strcmp(argv[i], "--versions") == 0 && i + 1 < argc) maximoVersiones = atol(argv[++i]);
+        else if (strcmp(argv[i], "--import") == 0 && i + 1 < argc) archivoImportar = argv[++i];
+        else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc) archivoBitacora = argv[++i];
+        else if (strcmp(argv[i], "--group-commit") == 0 && i + 1 < argc) grupoOperaciones = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--group-ms") == 0 && i + 1 < argc) grupoMilisegundos = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--policy") == 0 && i + 1 < argc &&
+                 politicaDesdeTexto(argv[i + 1], strlen(argv[i + 1])) >= 0) {
+            ++i;
+            politica = (PoliticaUbicacion)politicaDesdeTexto(argv[i], strlen(argv[i]));
+        }
+        else if (strcmp(argv[i], "--clock") == 0 && i + 1 < argc &&
+                 modoRelojDesdeTexto(argv[i + 1], strlen(argv[i + 1])) >= 0) {
+            ++i;
+            reloj.cambiarModo((ModoReloj)modoRelojDesdeTexto(argv[i], strlen(argv[i])));
+        }
+        else {
+            fprintf(stderr, "Uso: %s [--snapshot archivo [--journal archivo [--group-commit n] [--group-ms t]]]"
+                            " [--batch archivo|-] [--serve ruta | --serve-tcp puerto] [--clock grueso|mono|sim] [--policy nivel|linajes|poblacion] [--metrics archivo] [--versions n] [--import archivo] [--bench-buscar n]"
+                            " [--bench [n] [--bench-out archivo] [--baseline archivo] [--tolerance pct]]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // Suite de benchmarks: resultados en JSON (uno por línea) y comparación opcional con una línea base
+    if (benchMaximo > 0) {
+        vector<ResultadoBench> resultados = ejecutarSuiteBench(benchMaximo);
+        ofstream archivoSalida;
+        if (benchSalida) archivoSalida.open(benchSalida);
+        ostream& out = benchSalida ? archivoSalida : cout;
+        for (size_t i = 0; i < resultados.size(); i++) escribirResultadoBench(out, resultados[i]);
+        if (benchBase && compararConLineaBase(resultados, leerLineaBase(benchBase), benchTolerancia) > 0) return 2;
+        return 0;
+    }
+    if (archivoBitacora && !archivoInstantanea) {
+        fprintf(stderr, "--journal necesita --snapshot (la bitacora guarda los cambios posteriores a la instantanea)\n");
+        return 1;
+    }
+
+    Arbol arbol; // Crea una instancia del árbol genealógico
+    arbol.politica = politica;
+    InstantaneaDeSesion sesion(arbol, archivoInstantanea, archivoBitacora);
+    sesion.bitacora.maxOperaciones = grupoOperaciones > 0 ? grupoOperaciones : 1;
+    sesion.bitacora.maxMilisegundos = grupoMilisegundos >= 0 ? grupoMilisegundos : 0;
+    if (!sesion.cargar()) return 1;
+    if (archivoImportar) { // Con --snapshot queda guardado enseguida (y la bitácora empieza vacía)
+        string error;
+        chrono::steady_clock::time_point inicio = chrono::steady_clock::now();
+        if (!arbol.importarCsv(archivoImportar, error)) {
+            fprintf(stderr, "No se pudo importar %s:\n%s\n", archivoImportar, error.c_str());
+            return 1;
+        }
+        fprintf(stderr, "Importados %lu personajes en %.2f s\n", (unsigned long)arbol.indice.vivos,
+                chrono::duration<double>(chrono::steady_clock::now() - inicio).count());
+        if (!sesion.guardar()) return 1;
+    }
+
+    // Historial de versiones: la versión 0 es el árbol tal como quedó después de cargar la sesión
+    HistorialVersiones historial(maximoVersiones > 0 ? (size_t)maximoVersiones : 1);
+    if (maximoVersiones > 0) {
+        arbol.historial = &historial;
+        historial.comenzar(arbol.raiz);
+    }
+
+    // Con --metrics deja el volcado al terminar, en cualquiera de los modos
+    auto volcarMetricas = [&]() {
+        string error;
+        if (archivoMetricas && !guardarMetricas(archivoMetricas, arbol, formatoMetricasDeRuta(archivoMetricas), error))
+            fprintf(stderr, "%s\n", error.c_str());
+    };
+
+    // Modo por lotes: aplica los comandos sin mostrar el menú
+    if (archivoLote) {
+        FILE* archivo = strcmp(archivoLote, "-") == 0 ? stdin : fopen(archivoLote, "rb");
+        if (!archivo) {
+            fprintf(stderr, "No se pudo abrir %s\n", archivoLote);
+            return 1;
+        }
+        long errores = ejecutarLote(arbol, archivo);
+        if (archivo != stdin) fclose(archivo);
+        fprintf(stderr, "Lote terminado: %lu personajes, %ld errores\n", (unsigned long)arbol.indice.vivos, errores);
+        volcarMetricas();
+        if (!sesion.guardar()) return 1;
+        return errores ? 1 : 0;
+    }
+
+    // Modo servicio: atiende clientes por un socket local hasta recibir SIGINT o SIGTERM
+    if (socketServicio || puertoServicio > 0) {
+#ifdef __linux__
+        ServicioArbol servicio(arbol);
+        if (socketServicio ? !servicio.abrirUnix(socketServicio) : !servicio.abrirTcp(puertoServicio)) return 1;
+        fprintf(stderr, "Sirviendo en %s%s\n", socketServicio ? socketServicio : "127.0.0.1:",
+                socketServicio ? "" : to_string(puertoServicio).c_str());
+        int codigo = servicio.ejecutar();
+        volcarMetricas();
+        if (!sesion.guardar()) return 1;
+        return codigo;
+#else
+        fprintf(stderr, "El modo servicio solo esta disponible en Linux (epoll)\n");
+        return 1;
+#endif
+    }
+
     int op;      // Variable para almacenar la opción del menú
 
     do { // Bucle principal del menú
@@ -389,9 +5506,25 @@ int main() {
         cout << "5. Recorrido Inorden\n";
         cout << "6. Recorrido Postorden\n";
         cout << "7. Mostrar arbol	\n";
-        cout << "8. Salir\n";
+        cout << "8. Listar personajes eliminables\n";
+        cout << "9. Eliminar todos los eliminables\n";
+        cout << "10. Parentesco entre dos personajes\n";
+        cout << "11. Estadisticas de un linaje\n";
+        cout << "12. Buscar por nombre\n";
+        cout << "13. Filtrar por atributos\n";
+        cout << "14. Cambiar estado de un personaje\n";
+        cout << "15. Metricas de rendimiento\n";
+        cout << "16. Deshacer el ultimo cambio\n";
+        cout << "17. Rehacer\n";
+        cout << "18. Ver una version anterior\n";
+        cout << "19. Importar personajes (CSV/TSV)\n";
+        cout << "20. Exportar (DOT, NDJSON o CSV)\n";
+        cout << "21. Politica de ubicacion automatica\n";
+        cout << "0. Salir\n";
         cout << "Opcion: ";
-        cin >> op; // Lee la opción del usuario
+        if (arbol.bitacora) arbol.bitacora->confirmar(); // Nada queda sin fsync mientras se espera al usuario
+        if (!(cin >> op)) break; // Lee la opción del usuario (termina si se acabó la entrada)
+        reloj.refrescar(); // Cada opción es un lote nuevo para el reloj grueso
 
         switch(op) { // Estructura de control para ejecutar la función según la opción
             case 1: arbol.insertar(); break; // Llama a la función para insertar
@@ -401,10 +5534,26 @@ int main() {
             case 5: arbol.inorden(); break; // Ejecuta el recorrido inorden
             case 6: arbol.postorden(); break; // Ejecuta el recorrido postorden
             case 7: arbol.mostrarArbolVertical(); break; // Muestra el diagrama vertical
+            case 8: arbol.listarEliminables(); break; // Hojas con 60 "años" o más
+            case 9: arbol.eliminarTodosEliminables(); break; // Elimina todas esas hojas
+            case 10: arbol.mostrarParentesco(); break; // Ancestro común y grado entre dos personajes
+            case 11: arbol.mostrarEstadisticas(); break; // Contadores del subárbol de un personaje
+            case 12: arbol.buscarNombres(); break; // Por prefijo y por nombres parecidos
+            case 13: arbol.filtrarPorAtributos(); break; // AND/OR/NOT sobre tipo, género y estado
+            case 14: arbol.editarEstado(); break; // Vivo o Muerto
+            case 15: mostrarMetricas(arbol); break; // Latencias por operación y memoria
+            case 16: arbol.deshacerUltimo(false); break; // Vuelve a la versión anterior
+            case 17: arbol.deshacerUltimo(true); break;  // Vuelve a aplicar lo deshecho
+            case 18: arbol.verVersionAnterior(); break;  // El árbol como era en otra versión
+            case 19: arbol.importarArchivo(); break;     // Reemplaza el árbol por un CSV/TSV
+            case 20: arbol.exportarInteractivo(); break; // Todo el árbol o un linaje, a un archivo
+            case 21: arbol.elegirPolitica(); break;      // Cómo se elige el padre automático
         }
 
-    } while(op != 8); // El bucle se repite mientras la opción no sea 8 (Salir)
+    } while(op != 0); // El bucle se repite mientras la opción no sea 0 (Salir)
 
+    volcarMetricas();
+    if (!sesion.guardar()) return 1; // Con --snapshot, guarda el árbol antes de terminar
     return 0; // Retorna 0, indicando que el programa terminó con éxito
 }
 